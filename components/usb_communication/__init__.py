@@ -1,6 +1,29 @@
+from esphome import automation
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+from esphome.const import CONF_ID, CONF_PRIORITY, CONF_THRESHOLD, CONF_TRIGGER_ID
+
+CONF_CLIP_CACHE_SIZE = "clip_cache_size"
+CONF_CORE = "core"
+CONF_HANGOVER = "hangover"
+CONF_LATENCY_TRACE = "latency_trace"
+CONF_MAX_LINE_LENGTH = "max_line_length"
+CONF_MIC_CHANNEL = "mic_channel"
+CONF_MIC_RING = "mic_ring_ms"
+CONF_ON_CONFIG = "on_config"
+CONF_ON_PLAYBACK_COMPLETE = "on_playback_complete"
+CONF_ON_TONE = "on_tone"
+CONF_ON_UNMUTE = "on_unmute"
+CONF_ON_VOLUME_CHANGE = "on_volume_change"
+CONF_PLAYBACK_BUFFER_SIZE = "playback_buffer_size"
+CONF_PREBUFFER = "prebuffer"
+CONF_PREROLL = "preroll"
+CONF_STACK_SIZE = "stack_size"
+CONF_TASK = "task"
+CONF_USE_PSRAM = "use_psram"
+CONF_UPLINK_MODE = "uplink_mode"
+CONF_VNR_GATE = "vnr_gate"
+CONF_VOICE_KIT_ID = "voice_kit_id"
 
 # No dependencies needed - uses USB Serial/JTAG directly
 DEPENDENCIES = []
@@ -9,14 +32,181 @@ usb_communication_ns = cg.esphome_ns.namespace("usb_communication")
 USBCommunicationComponent = usb_communication_ns.class_(
     "USBCommunicationComponent", cg.Component
 )
+VoiceKit = cg.esphome_ns.namespace("voice_kit").class_("VoiceKit", cg.Component)
+MicChannel = usb_communication_ns.enum("MicChannel")
+MIC_CHANNELS = {
+    "left": MicChannel.MIC_CHANNEL_LEFT,
+    "right": MicChannel.MIC_CHANNEL_RIGHT,
+    "mix": MicChannel.MIC_CHANNEL_MIX,
+}
+VolumeChangeTrigger = usb_communication_ns.class_(
+    "VolumeChangeTrigger", automation.Trigger.template(cg.float_)
+)
+UnmuteTrigger = usb_communication_ns.class_(
+    "UnmuteTrigger", automation.Trigger.template()
+)
+ToneTrigger = usb_communication_ns.class_(
+    "ToneTrigger", automation.Trigger.template(cg.uint16, cg.uint16)
+)
+PlaybackCompleteTrigger = usb_communication_ns.class_(
+    "PlaybackCompleteTrigger", automation.Trigger.template()
+)
+ConfigTrigger = usb_communication_ns.class_(
+    "ConfigTrigger", automation.Trigger.template(cg.std_string, cg.std_string)
+)
+UplinkMode = usb_communication_ns.enum("UplinkMode")
+UPLINK_MODES = {
+    "mono": UplinkMode.UPLINK_MONO,
+    "stereo": UplinkMode.UPLINK_STEREO,
+    "auto": UplinkMode.UPLINK_AUTO,
+}
 
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(USBCommunicationComponent),
+        cv.Optional(
+            CONF_PREBUFFER, default="30ms"
+        ): cv.positive_time_period_milliseconds,
+        # Run the USB pipeline in its own task so protocol latency does not depend on main loop load
+        cv.Optional(CONF_TASK): cv.Schema(
+            {
+                cv.Optional(CONF_CORE, default=1): cv.int_range(min=0, max=1),
+                cv.Optional(CONF_PRIORITY, default=10): cv.int_range(min=1, max=24),
+                cv.Optional(CONF_STACK_SIZE, default=8192): cv.int_range(
+                    min=4096, max=32768
+                ),
+            }
+        ),
+        cv.Optional(CONF_LATENCY_TRACE, default=False): cv.boolean,
+        cv.Optional(CONF_PLAYBACK_BUFFER_SIZE, default=16384): cv.int_range(
+            min=4096, max=4 * 1024 * 1024
+        ),
+        # Clips the host uploads once and replays by ID; taken from the same arena as the playback buffer
+        cv.Optional(CONF_CLIP_CACHE_SIZE, default=0): cv.int_range(
+            min=0, max=4 * 1024 * 1024
+        ),
+        cv.Optional(CONF_MIC_RING, default="200ms"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Range(
+                min=cv.TimePeriod(milliseconds=40), max=cv.TimePeriod(seconds=10)
+            ),
+        ),
+        # Mono history that opens every mono uplink, so speech right before the trigger is not clipped; 0ms disables it
+        cv.Optional(CONF_PREROLL, default="500ms"): cv.All(
+            cv.positive_time_period_milliseconds,
+            cv.Any(
+                cv.Range(max=cv.TimePeriod(milliseconds=0)),
+                cv.Range(
+                    min=cv.TimePeriod(milliseconds=300),
+                    max=cv.TimePeriod(milliseconds=1000),
+                ),
+            ),
+        ),
+        cv.Optional(CONF_USE_PSRAM, default=True): cv.boolean,
+        # Longest JSON control line; allocated up front alongside the playback buffer
+        cv.Optional(CONF_MAX_LINE_LENGTH, default=16384): cv.int_range(
+            min=512, max=64 * 1024
+        ),
+        cv.Optional(CONF_MIC_CHANNEL, default="left"): cv.enum(
+            MIC_CHANNELS, lower=True
+        ),
+        # Default for start_capture messages that do not pick a mode
+        cv.Optional(CONF_UPLINK_MODE, default="mono"): cv.enum(
+            UPLINK_MODES, lower=True
+        ),
+        # Lets the host stream XMOS firmware updates over USB instead of embedding the image
+        cv.Optional(CONF_VOICE_KIT_ID): cv.use_id(VoiceKit),
+        # Suppress uplink audio while the XMOS voice-to-noise ratio says there is only room noise
+        cv.Optional(CONF_VNR_GATE): cv.Schema(
+            {
+                cv.Optional(CONF_THRESHOLD, default=30): cv.int_range(min=0, max=100),
+                cv.Optional(
+                    CONF_HANGOVER, default="500ms"
+                ): cv.positive_time_period_milliseconds,
+            }
+        ),
+        # Host requests, delivered as they are handled instead of being polled from an interval
+        cv.Optional(CONF_ON_VOLUME_CHANGE): automation.validate_automation(
+            {cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(VolumeChangeTrigger)}
+        ),
+        cv.Optional(CONF_ON_UNMUTE): automation.validate_automation(
+            {cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(UnmuteTrigger)}
+        ),
+        cv.Optional(CONF_ON_TONE): automation.validate_automation(
+            {cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(ToneTrigger)}
+        ),
+        cv.Optional(CONF_ON_PLAYBACK_COMPLETE): automation.validate_automation(
+            {
+                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(
+                    PlaybackCompleteTrigger
+                )
+            }
+        ),
+        cv.Optional(CONF_ON_CONFIG): automation.validate_automation(
+            {cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(ConfigTrigger)}
+        ),
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
 
+def _validate_vnr_gate(config):
+    if CONF_VNR_GATE in config and CONF_VOICE_KIT_ID not in config:
+        raise cv.Invalid(f"{CONF_VNR_GATE} requires {CONF_VOICE_KIT_ID}")
+    return config
+
+
+CONFIG_SCHEMA = cv.All(CONFIG_SCHEMA, _validate_vnr_gate)
+
+
 async def to_code(config):
     var = cg.new_Pvariable(config[CONF_ID])
-    await cg.register_component(var, config)
\ No newline at end of file
+    await cg.register_component(var, config)
+
+    cg.add(var.set_prebuffer_ms(config[CONF_PREBUFFER]))
+    cg.add(var.set_playback_buffer_size(config[CONF_PLAYBACK_BUFFER_SIZE]))
+    cg.add(var.set_clip_cache_size(config[CONF_CLIP_CACHE_SIZE]))
+    cg.add(var.set_mic_ring_ms(config[CONF_MIC_RING]))
+    cg.add(var.set_preroll_ms(config[CONF_PREROLL]))
+    cg.add(var.set_use_psram(config[CONF_USE_PSRAM]))
+    cg.add(var.set_max_line_length(config[CONF_MAX_LINE_LENGTH]))
+    cg.add(var.set_mic_channel(config[CONF_MIC_CHANNEL]))
+    cg.add(var.set_uplink_mode(config[CONF_UPLINK_MODE]))
+    if task := config.get(CONF_TASK):
+        cg.add(
+            var.set_task_config(
+                task[CONF_CORE], task[CONF_PRIORITY], task[CONF_STACK_SIZE]
+            )
+        )
+    if config[CONF_LATENCY_TRACE]:
+        cg.add_define("USE_USB_COMMUNICATION_TRACE")
+    if voice_kit_id := config.get(CONF_VOICE_KIT_ID):
+        voice_kit = await cg.get_variable(voice_kit_id)
+        cg.add(var.set_voice_kit(voice_kit))
+        cg.add_define("USE_USB_COMMUNICATION_VOICE_KIT")
+        cg.add_define("USE_VOICE_KIT_STATE_CALLBACK")
+        if vnr_gate := config.get(CONF_VNR_GATE):
+            cg.add(
+                var.set_vnr_gate(vnr_gate[CONF_THRESHOLD], vnr_gate[CONF_HANGOVER])
+            )
+
+    for conf in config.get(CONF_ON_VOLUME_CHANGE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [(float, "x")], conf)
+    for conf in config.get(CONF_ON_UNMUTE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [], conf)
+    for conf in config.get(CONF_ON_TONE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(
+            trigger, [(cg.uint16, "frequency"), (cg.uint16, "duration_ms")], conf
+        )
+    for conf in config.get(CONF_ON_PLAYBACK_COMPLETE, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(trigger, [], conf)
+    for conf in config.get(CONF_ON_CONFIG, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(
+            trigger,
+            [(cg.std_string, "wake_word"), (cg.std_string, "sensitivity")],
+            conf,
+        )
@@ -0,0 +1,43 @@
+#include "audio_arena.h"
+
+#include "esp_heap_caps.h"
+
+namespace esphome {
+namespace usb_communication {
+
+AudioArena::~AudioArena() {
+  if (this->base_ != nullptr) {
+    heap_caps_free(this->base_);
+  }
+}
+
+bool AudioArena::init(size_t size, bool prefer_psram) {
+  if (this->base_ != nullptr) {
+    return false;
+  }
+  if (prefer_psram) {
+    this->base_ = static_cast<uint8_t *>(heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    this->psram_ = this->base_ != nullptr;
+  }
+  if (this->base_ == nullptr) {
+    this->base_ = static_cast<uint8_t *>(heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+  }
+  if (this->base_ == nullptr) {
+    return false;
+  }
+  this->size_ = size;
+  this->used_ = 0;
+  return true;
+}
+
+void *AudioArena::allocate_bytes_(size_t bytes, size_t alignment) {
+  size_t offset = (this->used_ + alignment - 1) & ~(alignment - 1);
+  if (this->base_ == nullptr || offset > this->size_ || bytes > this->size_ - offset) {
+    return nullptr;
+  }
+  this->used_ = offset + bytes;
+  return this->base_ + offset;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
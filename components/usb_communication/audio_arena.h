@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Bump allocator over one block reserved at setup() for the component's audio buffers.
+//
+// Everything is carved out once and lives as long as the component, so there is no free(); one large allocation
+// keeps multi-second playback buffers from fragmenting internal RAM. The block comes from PSRAM when available and
+// falls back to internal RAM otherwise.
+class AudioArena {
+ public:
+  ~AudioArena();
+
+  // Reserves `size` bytes; returns false if neither PSRAM nor internal RAM can hold them
+  bool init(size_t size, bool prefer_psram = true);
+
+  // Returns nullptr once the arena is exhausted
+  template<typename T> T *allocate(size_t count) {
+    return static_cast<T *>(this->allocate_bytes_(count * sizeof(T), alignof(T)));
+  }
+
+  size_t size() const { return this->size_; }
+  size_t used() const { return this->used_; }
+  bool is_psram() const { return this->psram_; }
+
+ protected:
+  void *allocate_bytes_(size_t bytes, size_t alignment);
+
+  uint8_t *base_{nullptr};
+  size_t size_{0};
+  size_t used_{0};
+  bool psram_{false};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,49 @@
+#pragma once
+#include "usb_communication.h"
+
+#include "esphome/core/automation.h"
+
+namespace esphome {
+namespace usb_communication {
+
+class VolumeChangeTrigger : public Trigger<float> {
+ public:
+  explicit VolumeChangeTrigger(USBCommunicationComponent *parent) {
+    parent->add_on_volume_change_callback([this](float volume) { this->trigger(volume); });
+  }
+};
+
+class UnmuteTrigger : public Trigger<> {
+ public:
+  explicit UnmuteTrigger(USBCommunicationComponent *parent) {
+    parent->add_on_unmute_callback([this]() { this->trigger(); });
+  }
+};
+
+class ToneTrigger : public Trigger<uint16_t, uint16_t> {
+ public:
+  explicit ToneTrigger(USBCommunicationComponent *parent) {
+    parent->add_on_tone_callback([this](uint16_t frequency, uint16_t duration_ms) {
+      this->trigger(frequency, duration_ms);
+    });
+  }
+};
+
+class PlaybackCompleteTrigger : public Trigger<> {
+ public:
+  explicit PlaybackCompleteTrigger(USBCommunicationComponent *parent) {
+    parent->add_on_playback_complete_callback([this]() { this->trigger(); });
+  }
+};
+
+class ConfigTrigger : public Trigger<std::string, std::string> {
+ public:
+  explicit ConfigTrigger(USBCommunicationComponent *parent) {
+    parent->add_on_config_callback([this](const std::string &wake_word, const std::string &sensitivity) {
+      this->trigger(wake_word, sensitivity);
+    });
+  }
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,80 @@
+#include "base64_decoder.h"
+
+namespace esphome {
+namespace usb_communication {
+
+namespace {
+
+static const int8_t B64_INVALID = -1;
+static const int8_t B64_SKIP = -2;
+static const int8_t B64_PAD = -3;
+
+struct Base64Table {
+  int8_t values[256];
+  constexpr Base64Table() : values() {
+    for (int i = 0; i < 256; i++) {
+      this->values[i] = B64_INVALID;
+    }
+    for (int i = 0; i < 26; i++) {
+      this->values['A' + i] = i;
+      this->values['a' + i] = 26 + i;
+    }
+    for (int i = 0; i < 10; i++) {
+      this->values['0' + i] = 52 + i;
+    }
+    this->values['+'] = 62;
+    this->values['/'] = 63;
+    this->values['='] = B64_PAD;
+    this->values['\\'] = B64_SKIP;
+    this->values[' '] = B64_SKIP;
+    this->values['\r'] = B64_SKIP;
+    this->values['\n'] = B64_SKIP;
+  }
+};
+
+constexpr Base64Table BASE64_TABLE{};
+
+}  // namespace
+
+size_t Base64Decoder::decode(const char *input, size_t length, uint8_t *output, size_t output_size,
+                             size_t *consumed) {
+  size_t in = 0;
+  size_t out = 0;
+
+  while (in < length) {
+    int8_t value = BASE64_TABLE.values[static_cast<uint8_t>(input[in])];
+    if (value == B64_SKIP) {
+      in++;
+      continue;
+    }
+    if (value == B64_PAD) {
+      // Padding ends a group; leftover bits are zero fill
+      this->accumulator_ = 0;
+      this->bits_ = 0;
+      in++;
+      continue;
+    }
+    if (value == B64_INVALID) {
+      this->error_ = true;
+      break;
+    }
+    // Each character adds 6 bits; a byte is ready whenever 8 have accumulated
+    if (this->bits_ >= 2 && out == output_size) {
+      break;
+    }
+    this->accumulator_ = (this->accumulator_ << 6) | value;
+    this->bits_ += 6;
+    in++;
+    if (this->bits_ >= 8) {
+      this->bits_ -= 8;
+      output[out++] = static_cast<uint8_t>(this->accumulator_ >> this->bits_);
+      this->accumulator_ &= (1u << this->bits_) - 1;
+    }
+  }
+
+  *consumed = in;
+  return out;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Incremental, table-driven base64 decoder.
+//
+// Input can be fed in arbitrary pieces (not necessarily multiples of four characters); partial groups are carried
+// over to the next decode() call. Whitespace and the JSON escape backslash in "\/" are skipped, padding closes
+// the current group.
+class Base64Decoder {
+ public:
+  void reset() {
+    this->accumulator_ = 0;
+    this->bits_ = 0;
+    this->error_ = false;
+  }
+
+  // Decodes as much of `input` as fits into `output`. Returns the number of bytes written and stores the number of
+  // input characters used in `consumed`. Stops early (with has_error() set) on a character outside the alphabet.
+  size_t decode(const char *input, size_t length, uint8_t *output, size_t output_size, size_t *consumed);
+
+  bool has_error() const { return this->error_; }
+
+ protected:
+  uint32_t accumulator_{0};
+  uint8_t bits_{0};
+  bool error_{false};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,61 @@
+#include "channel_selector.h"
+
+namespace esphome {
+namespace usb_communication {
+
+void ChannelSelector::reset(uint8_t channel) {
+  this->floor_[0] = 0;
+  this->floor_[1] = 0;
+  this->channel_ = channel & 1;
+  this->wins_ = 0;
+  this->switches_ = 0;
+}
+
+uint8_t ChannelSelector::process(const int16_t *interleaved, size_t frame_count, bool voice, int16_t *out) {
+  if (frame_count == 0) {
+    return this->channel_;
+  }
+
+  uint32_t sum[2] = {0, 0};
+  for (size_t i = 0; i < frame_count; i++) {
+    int32_t left = interleaved[2 * i];
+    int32_t right = interleaved[2 * i + 1];
+    sum[0] += left < 0 ? -left : left;
+    sum[1] += right < 0 ? -right : right;
+  }
+
+  uint32_t score[2];
+  for (uint8_t c = 0; c < 2; c++) {
+    uint32_t level = (sum[c] << 4) / frame_count;
+    // Minimum tracking: the floor drops straight to quieter blocks and creeps up ~1.5% per block otherwise, so it
+    // follows the noise between words rather than the speech itself
+    if (this->floor_[c] == 0 || level < this->floor_[c]) {
+      this->floor_[c] = level;
+    } else {
+      this->floor_[c] += (this->floor_[c] >> 6) + 1;
+    }
+    uint32_t floor = this->floor_[c] > 16 ? this->floor_[c] : 16;
+    score[c] = static_cast<uint32_t>((static_cast<uint64_t>(level) << 8) / floor);
+  }
+
+  uint8_t other = this->channel_ ^ 1;
+  // The other channel must beat the current one by 25%
+  if (voice && score[other] > score[this->channel_] + (score[this->channel_] >> 2)) {
+    if (++this->wins_ >= SWITCH_FRAMES) {
+      this->channel_ = other;
+      this->wins_ = 0;
+      this->switches_++;
+    }
+  } else {
+    this->wins_ = 0;
+  }
+
+  const int16_t *source = interleaved + this->channel_;
+  for (size_t i = 0; i < frame_count; i++) {
+    out[i] = source[2 * i];
+  }
+  return this->channel_;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
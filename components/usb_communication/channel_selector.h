@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Picks one of the two XMOS output channels for a mono uplink.
+//
+// The XMOS reports a single VNR for its processed output, not one per channel, so VNR decides *when* the choice may
+// change and the channels are compared on their own signal-to-noise estimate: each channel's level over its tracked
+// noise floor. Switching only while VNR says speech is present keeps the uplink from hopping between channels on
+// room noise, and a channel has to win by a margin for several frames in a row before it takes over.
+class ChannelSelector {
+ public:
+  static const uint8_t SWITCH_FRAMES = 3;
+
+  void reset(uint8_t channel = 0);
+  uint8_t channel() const { return this->channel_; }
+  uint32_t switches() const { return this->switches_; }
+
+  // Copies the selected channel of frame_count interleaved stereo frames to `out` (frame_count samples), after
+  // updating the choice with this block. Returns the channel that was copied.
+  uint8_t process(const int16_t *interleaved, size_t frame_count, bool voice, int16_t *out);
+
+ protected:
+  // Levels are mean absolute sample values in Q4
+  uint32_t floor_[2]{0, 0};
+  uint8_t channel_{0};
+  uint8_t wins_{0};
+  uint32_t switches_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,175 @@
+#include "clip_cache.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+void ClipCache::init(uint8_t *storage, size_t capacity) {
+  this->storage_ = storage;
+  this->capacity_ = storage != nullptr ? capacity : 0;
+  this->end_ = 0;
+  for (Clip &clip : this->clips_) {
+    clip.used = false;
+  }
+  this->receiving_ = NO_CLIP;
+}
+
+size_t ClipCache::count() const {
+  size_t count = 0;
+  for (int slot = 0; slot < static_cast<int>(MAX_CLIPS); slot++) {
+    if (this->clips_[slot].used && slot != this->receiving_) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int ClipCache::find_slot_(std::string_view id) const {
+  for (int slot = 0; slot < static_cast<int>(MAX_CLIPS); slot++) {
+    const Clip &clip = this->clips_[slot];
+    if (clip.used && id == clip.id) {
+      return slot;
+    }
+  }
+  return NO_CLIP;
+}
+
+int ClipCache::find(std::string_view id) const {
+  int slot = this->find_slot_(id);
+  return slot == this->receiving_ ? NO_CLIP : slot;
+}
+
+bool ClipCache::has(std::string_view id, std::string_view hash) const {
+  int slot = this->find(id);
+  return slot != NO_CLIP && hash == this->clips_[slot].hash;
+}
+
+void ClipCache::touch(int slot) { this->clips_[slot].last_used = ++this->use_counter_; }
+
+int ClipCache::begin(std::string_view id, std::string_view hash, size_t size, uint32_t sample_rate, int pinned) {
+  if (id.empty() || id.size() > MAX_ID_LENGTH || hash.size() > MAX_HASH_LENGTH || size == 0) {
+    return NO_CLIP;
+  }
+  size_t reserved = pinned != NO_CLIP ? this->clips_[pinned].size : 0;
+  if (size > this->capacity_ - reserved) {
+    return NO_CLIP;
+  }
+  int existing = this->find_slot_(id);
+  if (existing != NO_CLIP && existing == pinned) {
+    return NO_CLIP;
+  }
+  this->abort();
+  existing = this->find_slot_(id);
+  if (existing != NO_CLIP) {
+    this->remove_(existing);
+  }
+  this->compact_();
+
+  // Least recently played first; the pinned clip alone always leaves enough room, checked above
+  while (this->capacity_ - this->end_ < size) {
+    this->evict_(pinned);
+  }
+  int free_slot = NO_CLIP;
+  for (int slot = 0; slot < static_cast<int>(MAX_CLIPS) && free_slot == NO_CLIP; slot++) {
+    if (!this->clips_[slot].used) {
+      free_slot = slot;
+    }
+  }
+  if (free_slot == NO_CLIP) {
+    // Every slot holds a clip; the oldest makes way even though its bytes were not needed
+    free_slot = this->evict_(pinned);
+  }
+
+  Clip &clip = this->clips_[free_slot];
+  memcpy(clip.id, id.data(), id.size());
+  clip.id[id.size()] = '\0';
+  memcpy(clip.hash, hash.data(), hash.size());
+  clip.hash[hash.size()] = '\0';
+  clip.offset = this->end_;
+  clip.size = size;
+  clip.received = 0;
+  clip.sample_rate = sample_rate;
+  clip.last_used = ++this->use_counter_;
+  clip.used = true;
+  this->end_ += size;
+  this->receiving_ = free_slot;
+  return free_slot;
+}
+
+bool ClipCache::append(const uint8_t *data, size_t length) {
+  if (this->receiving_ == NO_CLIP) {
+    return false;
+  }
+  Clip &clip = this->clips_[this->receiving_];
+  if (length > clip.size - clip.received) {
+    return false;
+  }
+  memcpy(this->storage_ + clip.offset + clip.received, data, length);
+  clip.received += length;
+  if (clip.received == clip.size) {
+    this->receiving_ = NO_CLIP;
+  }
+  return true;
+}
+
+void ClipCache::abort() {
+  if (this->receiving_ != NO_CLIP) {
+    this->remove_(this->receiving_);
+    this->receiving_ = NO_CLIP;
+  }
+}
+
+size_t ClipCache::received() const {
+  return this->receiving_ != NO_CLIP ? this->clips_[this->receiving_].received : 0;
+}
+
+int ClipCache::evict_(int pinned) {
+  int oldest = NO_CLIP;
+  for (int slot = 0; slot < static_cast<int>(MAX_CLIPS); slot++) {
+    const Clip &clip = this->clips_[slot];
+    if (clip.used && slot != pinned && (oldest == NO_CLIP || clip.last_used < this->clips_[oldest].last_used)) {
+      oldest = slot;
+    }
+  }
+  this->remove_(oldest);
+  this->compact_();
+  this->evictions_++;
+  return oldest;
+}
+
+void ClipCache::remove_(int slot) {
+  Clip &clip = this->clips_[slot];
+  clip.used = false;
+  // The clip being received is always the last one, so dropping it just shortens the used space
+  if (clip.offset + clip.size == this->end_) {
+    this->end_ = clip.offset;
+  }
+}
+
+void ClipCache::compact_() {
+  // Move clips down in offset order so every gap ends up at the end
+  size_t packed = 0;
+  while (true) {
+    int next = NO_CLIP;
+    for (int slot = 0; slot < static_cast<int>(MAX_CLIPS); slot++) {
+      const Clip &clip = this->clips_[slot];
+      if (clip.used && clip.offset >= packed && (next == NO_CLIP || clip.offset < this->clips_[next].offset)) {
+        next = slot;
+      }
+    }
+    if (next == NO_CLIP) {
+      break;
+    }
+    Clip &clip = this->clips_[next];
+    if (clip.offset != packed) {
+      memmove(this->storage_ + packed, this->storage_ + clip.offset, clip.size);
+      clip.offset = packed;
+    }
+    packed += clip.size;
+  }
+  this->end_ = packed;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
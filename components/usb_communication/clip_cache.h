@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace esphome {
+namespace usb_communication {
+
+// Audio clips the host uploaded once and replays by ID (clip_upload_begin, has_clip, play_clip).
+//
+// Clips are int16 PCM packed back to back in one block reserved at setup(). When a new clip does not fit, the least
+// recently played clips are dropped and the rest are moved down to close the gaps, so the free space is always one
+// run at the end. Slot numbers stay the same while clips move, which lets playback hold a slot rather than a pointer.
+// Only used from the pipeline, so it needs no synchronisation.
+class ClipCache {
+ public:
+  static const size_t MAX_CLIPS = 32;
+  static const size_t MAX_ID_LENGTH = 32;
+  static const size_t MAX_HASH_LENGTH = 64;
+  static const int NO_CLIP = -1;
+
+  // Storage is owned by the caller
+  void init(uint8_t *storage, size_t capacity);
+
+  size_t capacity() const { return this->capacity_; }
+  size_t used() const { return this->end_; }
+  size_t count() const;
+  uint32_t evictions() const { return this->evictions_; }
+
+  // Slot of the complete clip with this ID, or NO_CLIP
+  int find(std::string_view id) const;
+  bool has(std::string_view id, std::string_view hash) const;
+  // Marks the clip as the most recently played
+  void touch(int slot);
+
+  // Starts receiving a clip of `size` bytes, replacing any clip with the same ID and evicting others until it fits.
+  // `pinned` is never evicted or replaced. Returns the new slot, or NO_CLIP if the clip cannot be made to fit.
+  int begin(std::string_view id, std::string_view hash, size_t size, uint32_t sample_rate, int pinned = NO_CLIP);
+  // Appends the next bytes of the clip being received; false if there is none or the bytes overrun its size
+  bool append(const uint8_t *data, size_t length);
+  // Drops a clip still being received
+  void abort();
+  // Slot of the clip being received, or NO_CLIP
+  int receiving() const { return this->receiving_; }
+  // Bytes of the clip being received so far; it can be found and played once the last one has arrived
+  size_t received() const;
+
+  const uint8_t *data(int slot) const { return this->storage_ + this->clips_[slot].offset; }
+  size_t size(int slot) const { return this->clips_[slot].size; }
+  uint32_t sample_rate(int slot) const { return this->clips_[slot].sample_rate; }
+  const char *id(int slot) const { return this->clips_[slot].id; }
+  const char *hash(int slot) const { return this->clips_[slot].hash; }
+
+ protected:
+  struct Clip {
+    char id[MAX_ID_LENGTH + 1];
+    char hash[MAX_HASH_LENGTH + 1];
+    size_t offset;
+    size_t size;
+    size_t received;
+    uint32_t sample_rate;
+    uint32_t last_used;
+    bool used;
+  };
+
+  int find_slot_(std::string_view id) const;
+  // Drops the least recently played clip other than `pinned` and returns its now free slot
+  int evict_(int pinned);
+  void remove_(int slot);
+  void compact_();
+
+  uint8_t *storage_{nullptr};
+  size_t capacity_{0};
+  size_t end_{0};  // everything past this is free
+  Clip clips_[MAX_CLIPS]{};
+  int receiving_{NO_CLIP};
+  uint32_t use_counter_{0};
+  uint32_t evictions_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,59 @@
+#include "device_state.h"
+
+#include <cstdio>
+
+namespace esphome {
+namespace usb_communication {
+
+namespace {
+
+void append_key(std::string &out, const char *key) {
+  out += ",\"";
+  out += key;
+  out += "\":";
+}
+
+void append_bool(std::string &out, const char *key, bool value) {
+  append_key(out, key);
+  out += value ? "true" : "false";
+}
+
+void append_float(std::string &out, const char *key, float value) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%.2f", value);
+  append_key(out, key);
+  out += buffer;
+}
+
+void append_string(std::string &out, const char *key, const std::string &value) {
+  append_key(out, key);
+  out += "\"";
+  out += value;
+  out += "\"";
+}
+
+}  // namespace
+
+void DeviceState::append_json(std::string &out, uint16_t fields) const {
+  if (fields & STATE_VOICE_PHASE) {
+    append_key(out, "voice_assistant_phase");
+    out += std::to_string(this->voice_phase);
+  }
+  if (fields & STATE_WAKE_WORD)
+    append_string(out, "wake_word", this->wake_word);
+  if (fields & STATE_SENSITIVITY)
+    append_string(out, "wake_word_sensitivity", this->sensitivity);
+  if (fields & STATE_WAKE_WORD_ACTIVE)
+    append_bool(out, "wake_word_active", this->wake_word_active);
+  if (fields & STATE_MICROPHONE_MUTED)
+    append_bool(out, "microphone_muted", this->microphone_muted);
+  if (fields & STATE_VOLUME)
+    append_float(out, "volume", this->volume);
+  if (fields & STATE_LED_BRIGHTNESS)
+    append_float(out, "led_brightness", this->led_brightness);
+  if (fields & STATE_TIMER_RINGING)
+    append_bool(out, "timer_ringing", this->timer_ringing);
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
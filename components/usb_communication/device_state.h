@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace esphome {
+namespace usb_communication {
+
+// One bit per field of DeviceState, used to track what changed since the last status push
+enum StateField : uint16_t {
+  STATE_VOICE_PHASE = 1 << 0,
+  STATE_WAKE_WORD = 1 << 1,
+  STATE_SENSITIVITY = 1 << 2,
+  STATE_WAKE_WORD_ACTIVE = 1 << 3,
+  STATE_MICROPHONE_MUTED = 1 << 4,
+  STATE_VOLUME = 1 << 5,
+  STATE_LED_BRIGHTNESS = 1 << 6,
+  STATE_TIMER_RINGING = 1 << 7,
+  STATE_ALL = (1 << 8) - 1,
+};
+
+// Device state reported to the host. Every change marks its field dirty, and commit() turns the dirty fields into
+// one new version, so the component can push just the changed fields (status_delta); the host applies deltas in
+// version order and asks for a full snapshot (get_status) if it sees a gap. Only state the USB configuration
+// actually has is reported: there are no timers, voice_assistant or network in USB mode.
+struct DeviceState {
+  int voice_phase{1};  // idle
+  std::string wake_word{"Okay Nabu"};
+  std::string sensitivity{"Moderately sensitive"};
+  bool wake_word_active{false};
+  bool microphone_muted{false};
+  float volume{0.7f};
+  float led_brightness{0.66f};
+  bool timer_ringing{false};
+
+  uint32_t version{0};
+  uint16_t dirty{0};
+
+  template<typename T> void set(StateField field, T &member, const T &value) {
+    if (member == value) {
+      return;
+    }
+    member = value;
+    this->dirty |= field;
+  }
+
+  // Bumps version once for everything changed since the last commit and returns the fields that changed
+  uint16_t commit() {
+    uint16_t fields = this->dirty;
+    if (fields != 0) {
+      this->version++;
+      this->dirty = 0;
+    }
+    return fields;
+  }
+
+  // Appends `"name":value` pairs for the given fields, each preceded by a comma
+  void append_json(std::string &out, uint16_t fields) const;
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
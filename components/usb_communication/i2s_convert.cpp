@@ -0,0 +1,127 @@
+#include "i2s_convert.h"
+
+#include <cstdlib>
+
+namespace esphome {
+namespace usb_communication {
+
+namespace {
+
+inline uint16_t peak_from_range(int32_t minimum, int32_t maximum) {
+  int32_t peak = maximum > -minimum ? maximum : -minimum;
+  return static_cast<uint16_t>(peak);
+}
+
+// The upper half of each little-endian 32-bit word is the 16-bit sample, so selecting a channel is a strided
+// halfword gather: no shifts, no clamping. Frame k's left sample is halfword 4k+1 and its right sample 4k+3.
+template<MicChannel CHANNEL> inline int32_t gather(const int16_t *halves, size_t frame) {
+  if (CHANNEL == MIC_CHANNEL_LEFT) {
+    return halves[4 * frame + 1];
+  }
+  if (CHANNEL == MIC_CHANNEL_RIGHT) {
+    return halves[4 * frame + 3];
+  }
+  return (static_cast<int32_t>(halves[4 * frame + 1]) + halves[4 * frame + 3]) >> 1;
+}
+
+template<MicChannel CHANNEL> uint16_t convert(const int32_t *frames, size_t frame_count, int16_t *out) {
+  const int16_t *halves = reinterpret_cast<const int16_t *>(frames);
+  int32_t minimum = 0;
+  int32_t maximum = 0;
+  size_t i = 0;
+
+  // Four frames per iteration keeps the loads independent and the min/max tracking branch-free
+  for (; i + 4 <= frame_count; i += 4) {
+    int32_t s0 = gather<CHANNEL>(halves, i);
+    int32_t s1 = gather<CHANNEL>(halves, i + 1);
+    int32_t s2 = gather<CHANNEL>(halves, i + 2);
+    int32_t s3 = gather<CHANNEL>(halves, i + 3);
+    out[i] = static_cast<int16_t>(s0);
+    out[i + 1] = static_cast<int16_t>(s1);
+    out[i + 2] = static_cast<int16_t>(s2);
+    out[i + 3] = static_cast<int16_t>(s3);
+    int32_t lo01 = s0 < s1 ? s0 : s1;
+    int32_t lo23 = s2 < s3 ? s2 : s3;
+    int32_t hi01 = s0 < s1 ? s1 : s0;
+    int32_t hi23 = s2 < s3 ? s3 : s2;
+    int32_t lo = lo01 < lo23 ? lo01 : lo23;
+    int32_t hi = hi01 < hi23 ? hi23 : hi01;
+    minimum = lo < minimum ? lo : minimum;
+    maximum = hi > maximum ? hi : maximum;
+  }
+  for (; i < frame_count; i++) {
+    int32_t sample = gather<CHANNEL>(halves, i);
+    out[i] = static_cast<int16_t>(sample);
+    minimum = sample < minimum ? sample : minimum;
+    maximum = sample > maximum ? sample : maximum;
+  }
+  return peak_from_range(minimum, maximum);
+}
+
+}  // namespace
+
+uint16_t convert_i2s_stereo_to_mono(const int32_t *frames, size_t frame_count, MicChannel channel, int16_t *out) {
+  switch (channel) {
+    case MIC_CHANNEL_RIGHT:
+      return convert<MIC_CHANNEL_RIGHT>(frames, frame_count, out);
+    case MIC_CHANNEL_MIX:
+      return convert<MIC_CHANNEL_MIX>(frames, frame_count, out);
+    case MIC_CHANNEL_LEFT:
+    default:
+      return convert<MIC_CHANNEL_LEFT>(frames, frame_count, out);
+  }
+}
+
+uint16_t convert_i2s_stereo_to_interleaved(const int32_t *frames, size_t frame_count, int16_t *out) {
+  // Every odd halfword is a sample, so both channels are a stride-2 gather over the whole block
+  const int16_t *halves = reinterpret_cast<const int16_t *>(frames);
+  size_t sample_count = 2 * frame_count;
+  int32_t minimum = 0;
+  int32_t maximum = 0;
+  size_t i = 0;
+
+  for (; i + 4 <= sample_count; i += 4) {
+    int32_t s0 = halves[2 * i + 1];
+    int32_t s1 = halves[2 * i + 3];
+    int32_t s2 = halves[2 * i + 5];
+    int32_t s3 = halves[2 * i + 7];
+    out[i] = static_cast<int16_t>(s0);
+    out[i + 1] = static_cast<int16_t>(s1);
+    out[i + 2] = static_cast<int16_t>(s2);
+    out[i + 3] = static_cast<int16_t>(s3);
+    int32_t lo01 = s0 < s1 ? s0 : s1;
+    int32_t lo23 = s2 < s3 ? s2 : s3;
+    int32_t hi01 = s0 < s1 ? s1 : s0;
+    int32_t hi23 = s2 < s3 ? s3 : s2;
+    int32_t lo = lo01 < lo23 ? lo01 : lo23;
+    int32_t hi = hi01 < hi23 ? hi23 : hi01;
+    minimum = lo < minimum ? lo : minimum;
+    maximum = hi > maximum ? hi : maximum;
+  }
+  for (; i < sample_count; i++) {
+    int32_t sample = halves[2 * i + 1];
+    out[i] = static_cast<int16_t>(sample);
+    minimum = sample < minimum ? sample : minimum;
+    maximum = sample > maximum ? sample : maximum;
+  }
+  return peak_from_range(minimum, maximum);
+}
+
+uint16_t convert_i2s_stereo_to_mono_reference(const int32_t *frames, size_t frame_count, MicChannel channel,
+                                              int16_t *out) {
+  uint16_t peak = 0;
+  for (size_t i = 0; i < frame_count; i++) {
+    int32_t left = frames[2 * i] >> 16;
+    int32_t right = frames[2 * i + 1] >> 16;
+    int32_t sample = channel == MIC_CHANNEL_LEFT ? left : channel == MIC_CHANNEL_RIGHT ? right : (left + right) >> 1;
+    out[i] = static_cast<int16_t>(sample);
+    uint16_t level = static_cast<uint16_t>(std::abs(sample));
+    if (level > peak) {
+      peak = level;
+    }
+  }
+  return peak;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
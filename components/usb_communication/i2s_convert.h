@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Which channel of the 32-bit stereo I2S stream becomes the 16-bit mono sample
+enum MicChannel : uint8_t {
+  MIC_CHANNEL_LEFT = 0,
+  MIC_CHANNEL_RIGHT = 1,
+  MIC_CHANNEL_MIX = 2,  // average of both channels
+};
+
+// Converts frame_count interleaved 32-bit stereo frames (sample in the upper 16 bits, as the I2S microphones
+// deliver it) into 16-bit mono in `out`, which must hold frame_count samples. Returns the peak absolute sample
+// value of the converted block, so callers get VU metering for free. Portable C++ unrolled by four frames, not
+// PIE/esp-dsp vector code.
+uint16_t convert_i2s_stereo_to_mono(const int32_t *frames, size_t frame_count, MicChannel channel, int16_t *out);
+
+// Keeps both channels: converts frame_count 32-bit stereo frames into frame_count interleaved 16-bit stereo frames
+// (left first) in `out`, which must hold 2 * frame_count samples. Returns the peak over both channels.
+uint16_t convert_i2s_stereo_to_interleaved(const int32_t *frames, size_t frame_count, int16_t *out);
+
+// Straightforward per-sample reference implementation; same results as convert_i2s_stereo_to_mono()
+uint16_t convert_i2s_stereo_to_mono_reference(const int32_t *frames, size_t frame_count, MicChannel channel,
+                                              int16_t *out);
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,69 @@
+#include "ima_adpcm.h"
+
+namespace esphome {
+namespace usb_communication {
+
+static const int16_t IMA_STEP_TABLE[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t IMA_INDEX_TABLE[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+bool ImaAdpcmDecoder::begin_block(const uint8_t *header, int16_t *first_sample) {
+  int16_t predictor = static_cast<int16_t>(header[0] | (header[1] << 8));
+  if (header[2] > 88) {
+    return false;
+  }
+  this->predictor_ = predictor;
+  this->step_index_ = header[2];
+  *first_sample = predictor;
+  return true;
+}
+
+void ImaAdpcmDecoder::decode(const uint8_t *data, size_t length, int16_t *output) {
+  for (size_t i = 0; i < length; i++) {
+    *output++ = this->decode_nibble_(data[i] & 0x0F);
+    *output++ = this->decode_nibble_(data[i] >> 4);
+  }
+}
+
+int16_t ImaAdpcmDecoder::decode_nibble_(uint8_t nibble) {
+  int32_t step = IMA_STEP_TABLE[this->step_index_];
+
+  // diff = (nibble magnitude + 0.5) * step / 4, computed with shifts as in the reference decoder
+  int32_t diff = step >> 3;
+  if (nibble & 4)
+    diff += step;
+  if (nibble & 2)
+    diff += step >> 1;
+  if (nibble & 1)
+    diff += step >> 2;
+
+  if (nibble & 8) {
+    this->predictor_ -= diff;
+  } else {
+    this->predictor_ += diff;
+  }
+  if (this->predictor_ > INT16_MAX) {
+    this->predictor_ = INT16_MAX;
+  } else if (this->predictor_ < INT16_MIN) {
+    this->predictor_ = INT16_MIN;
+  }
+
+  this->step_index_ += IMA_INDEX_TABLE[nibble];
+  if (this->step_index_ < 0) {
+    this->step_index_ = 0;
+  } else if (this->step_index_ > 88) {
+    this->step_index_ = 88;
+  }
+
+  return static_cast<int16_t>(this->predictor_);
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
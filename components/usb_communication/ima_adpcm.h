@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// IMA-ADPCM (4 bits per sample) decoder for mono 16-bit audio.
+//
+// Audio is sent in independent blocks, one per binary frame or audio_data_chunk message, so a lost block doesn't
+// corrupt the rest of the stream. The layout matches a mono WAV IMA-ADPCM block:
+//   [0..1]  initial predictor, little-endian int16 (also the first output sample)
+//   [2]     initial step index (0-88)
+//   [3]     reserved
+//   [4..]   packed samples, two per byte, low nibble first
+static const size_t IMA_ADPCM_BLOCK_HEADER_SIZE = 4;
+
+class ImaAdpcmDecoder {
+ public:
+  // Starts a new block from its header; returns false if the header is invalid
+  bool begin_block(const uint8_t *header, int16_t *first_sample);
+
+  // Decodes packed nibbles (two samples per input byte) with the state carried from earlier calls within the block
+  void decode(const uint8_t *data, size_t length, int16_t *output);
+
+  static size_t samples_in_block(size_t block_length) {
+    return block_length < IMA_ADPCM_BLOCK_HEADER_SIZE ? 0 : 1 + 2 * (block_length - IMA_ADPCM_BLOCK_HEADER_SIZE);
+  }
+
+ protected:
+  int16_t decode_nibble_(uint8_t nibble);
+
+  int32_t predictor_{0};
+  int8_t step_index_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
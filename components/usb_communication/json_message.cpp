@@ -0,0 +1,146 @@
+#include "json_message.h"
+
+namespace esphome {
+namespace usb_communication {
+
+static inline bool is_json_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+// Returns the position just past the closing quote of the string starting at `pos` (which points at the opening
+// quote), or nullptr if it is unterminated
+static const char *skip_string(const char *pos, const char *end) {
+  for (pos++; pos < end; pos++) {
+    if (*pos == '\\') {
+      pos++;
+    } else if (*pos == '"') {
+      return pos + 1;
+    }
+  }
+  return nullptr;
+}
+
+// Skips a balanced array or object, honouring strings so brackets inside them don't count
+static const char *skip_container(const char *pos, const char *end) {
+  int depth = 0;
+  while (pos < end) {
+    char c = *pos;
+    if (c == '"') {
+      pos = skip_string(pos, end);
+      if (pos == nullptr) {
+        return end;
+      }
+      continue;
+    }
+    if (c == '[' || c == '{') {
+      depth++;
+    } else if (c == ']' || c == '}') {
+      if (--depth == 0) {
+        return pos + 1;
+      }
+    }
+    pos++;
+  }
+  return end;
+}
+
+bool JsonMessage::parse(std::string_view text) {
+  this->field_count_ = 0;
+  const char *pos = text.data();
+  const char *end = pos + text.size();
+
+  while (pos < end && is_json_space(*pos))
+    pos++;
+  if (pos == end || *pos != '{') {
+    return false;
+  }
+  pos++;
+
+  while (pos < end) {
+    while (pos < end && (is_json_space(*pos) || *pos == ','))
+      pos++;
+    if (pos == end || *pos == '}') {
+      return true;
+    }
+    if (*pos != '"') {
+      return false;
+    }
+
+    const char *key_end = skip_string(pos, end);
+    if (key_end == nullptr) {
+      return false;
+    }
+    std::string_view key(pos + 1, key_end - pos - 2);
+    pos = key_end;
+    while (pos < end && (is_json_space(*pos) || *pos == ':'))
+      pos++;
+    if (pos == end) {
+      return false;
+    }
+
+    const char *value_start = pos;
+    bool is_string = false;
+    if (*pos == '"') {
+      pos = skip_string(pos, end);
+      if (pos == nullptr) {
+        return false;
+      }
+      is_string = true;
+    } else if (*pos == '[' || *pos == '{') {
+      pos = skip_container(pos, end);
+    } else {
+      while (pos < end && *pos != ',' && *pos != '}' && !is_json_space(*pos))
+        pos++;
+    }
+
+    if (this->field_count_ < MAX_FIELDS) {
+      Field &field = this->fields_[this->field_count_++];
+      field.key = key;
+      field.is_string = is_string;
+      if (is_string) {
+        field.value = std::string_view(value_start + 1, pos - value_start - 2);
+      } else {
+        field.value = std::string_view(value_start, pos - value_start);
+      }
+    }
+  }
+  return false;
+}
+
+const JsonMessage::Field *JsonMessage::find_(std::string_view key) const {
+  for (size_t i = 0; i < this->field_count_; i++) {
+    if (this->fields_[i].key == key) {
+      return &this->fields_[i];
+    }
+  }
+  return nullptr;
+}
+
+std::string_view JsonMessage::get_string(std::string_view key, std::string_view fallback) const {
+  const Field *field = this->find_(key);
+  return (field != nullptr && field->is_string) ? field->value : fallback;
+}
+
+std::string_view JsonMessage::get_raw(std::string_view key) const {
+  const Field *field = this->find_(key);
+  return field != nullptr ? field->value : std::string_view();
+}
+
+bool JsonMessage::get_bool(std::string_view key, bool fallback) const {
+  std::string_view raw = this->get_raw(key);
+  if (raw == "true") {
+    return true;
+  }
+  if (raw == "false") {
+    return false;
+  }
+  return fallback;
+}
+
+float JsonMessage::get_float(std::string_view key, float fallback) const {
+  std::string_view raw = this->get_raw(key);
+  float value;
+  auto result = std::from_chars(raw.data(), raw.data() + raw.size(), value);
+  return result.ec == std::errc() ? value : fallback;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace esphome {
+namespace usb_communication {
+
+// Single-pass tokenizer for the flat JSON objects used by the control protocol.
+//
+// parse() walks the message once and records a view of every top-level key and value; nothing is copied or
+// allocated, so the views are only valid while the message buffer is. String values are returned without their
+// quotes and without unescaping, arrays and nested objects as their raw text including brackets.
+class JsonMessage {
+ public:
+  bool parse(std::string_view text);
+
+  std::string_view type() const { return this->get_string("type"); }
+  bool has(std::string_view key) const { return this->find_(key) != nullptr; }
+
+  std::string_view get_string(std::string_view key, std::string_view fallback = {}) const;
+  std::string_view get_raw(std::string_view key) const;
+  bool get_bool(std::string_view key, bool fallback) const;
+  float get_float(std::string_view key, float fallback) const;
+
+  template<typename T> T get_int(std::string_view key, T fallback) const {
+    std::string_view raw = this->get_raw(key);
+    T value;
+    auto result = std::from_chars(raw.data(), raw.data() + raw.size(), value);
+    return result.ec == std::errc() ? value : fallback;
+  }
+
+ protected:
+  struct Field {
+    std::string_view key;
+    std::string_view value;
+    bool is_string;
+  };
+
+  const Field *find_(std::string_view key) const;
+
+  static const size_t MAX_FIELDS = 24;
+  Field fields_[MAX_FIELDS];
+  size_t field_count_{0};
+};
+
+// Calls callback(value) for each integer in a JSON array ("[1,-2,3]" or its contents) without allocating. Entries
+// that are not integers are skipped. Returns the number of values passed to the callback.
+template<typename F> size_t for_each_json_int(std::string_view array, F &&callback) {
+  const char *pos = array.data();
+  const char *end = pos + array.size();
+  size_t count = 0;
+  while (pos < end) {
+    // Skip brackets, separators and whitespace up to the start of a number
+    while (pos < end && *pos != '-' && (*pos < '0' || *pos > '9')) {
+      pos++;
+    }
+    if (pos == end) {
+      break;
+    }
+    long value;
+    auto result = std::from_chars(pos, end, value);
+    if (result.ec == std::errc()) {
+      callback(value);
+      count++;
+      pos = result.ptr;
+    } else {
+      pos++;
+    }
+  }
+  return count;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,62 @@
+#include "latency_trace.h"
+
+#ifdef USE_USB_COMMUNICATION_TRACE
+
+#include <algorithm>
+
+namespace esphome {
+namespace usb_communication {
+
+static const char *const TRACE_STAGE_NAMES[TRACE_STAGE_COUNT] = {
+    "rx_dispatch", "parse", "buffer_write", "first_play", "playback_drain", "mic_callback", "mic_inject", "mic_tx",
+};
+
+const char *trace_stage_name(TraceStage stage) {
+  return stage < TRACE_STAGE_COUNT ? TRACE_STAGE_NAMES[stage] : "unknown";
+}
+
+void LatencyTrace::record(TraceStage stage, uint32_t latency_us, uint32_t now_us) {
+  uint32_t sample = this->sample_counts_[stage].fetch_add(1, std::memory_order_relaxed);
+  this->samples_[stage][sample % SAMPLES_PER_STAGE] = latency_us;
+
+  uint32_t slot = this->event_count_.fetch_add(1, std::memory_order_relaxed) % EVENT_COUNT;
+  this->events_[slot] = {now_us, latency_us, stage};
+}
+
+TraceStats LatencyTrace::get_stats(TraceStage stage) const {
+  TraceStats stats{};
+  stats.count = this->sample_counts_[stage].load(std::memory_order_relaxed);
+
+  size_t n = std::min<size_t>(stats.count, SAMPLES_PER_STAGE);
+  if (n == 0) {
+    return stats;
+  }
+  uint32_t sorted[SAMPLES_PER_STAGE];
+  std::copy(this->samples_[stage], this->samples_[stage] + n, sorted);
+  std::sort(sorted, sorted + n);
+  stats.p50_us = sorted[(n - 1) / 2];
+  stats.p95_us = sorted[(n - 1) * 95 / 100];
+  stats.max_us = sorted[n - 1];
+  return stats;
+}
+
+size_t LatencyTrace::get_events(TraceEvent *events, size_t max_events) const {
+  uint32_t total = this->event_count_.load(std::memory_order_relaxed);
+  size_t n = std::min<size_t>({total, EVENT_COUNT, max_events});
+  for (size_t i = 0; i < n; i++) {
+    events[i] = this->events_[(total - n + i) % EVENT_COUNT];
+  }
+  return n;
+}
+
+void LatencyTrace::reset() {
+  for (auto &count : this->sample_counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  this->event_count_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
+
+#endif  // USE_USB_COMMUNICATION_TRACE
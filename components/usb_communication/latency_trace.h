@@ -0,0 +1,82 @@
+#pragma once
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_USB_COMMUNICATION_TRACE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+enum TraceStage : uint8_t {
+  // Downlink (host -> speaker)
+  TRACE_RX_DISPATCH = 0,  // bytes read from the driver until their frame/line is dispatched
+  TRACE_PARSE,            // tokenizing a message or validating a frame, up to the handler
+  TRACE_BUFFER_WRITE,     // write_audio_chunk()
+  TRACE_FIRST_PLAY,       // start_audio_stream() until the first accepted target_speaker_->play()
+  TRACE_PLAYBACK_DRAIN,   // finish_audio_stream() until the last byte was handed to the speaker
+  // Uplink (microphone -> host)
+  TRACE_MIC_CALLBACK,  // converting one microphone callback block
+  TRACE_MIC_INJECT,    // inject_audio_data()
+  TRACE_MIC_TX,        // age of the oldest sample when its frame is sent
+  TRACE_STAGE_COUNT,
+};
+
+const char *trace_stage_name(TraceStage stage);
+
+struct TraceEvent {
+  uint32_t timestamp_us;
+  uint32_t latency_us;
+  TraceStage stage;
+};
+
+struct TraceStats {
+  uint32_t count;
+  uint32_t p50_us;
+  uint32_t p95_us;
+  uint32_t max_us;
+};
+
+// Fixed-size latency recorder. record() is safe to call from the main loop and the microphone task at the same
+// time: slots are claimed atomically, so at worst a concurrently read sample is slightly stale.
+class LatencyTrace {
+ public:
+  static const size_t SAMPLES_PER_STAGE = 64;
+  static const size_t EVENT_COUNT = 128;
+
+  void record(TraceStage stage, uint32_t latency_us, uint32_t now_us);
+
+  TraceStats get_stats(TraceStage stage) const;
+  // Copies up to max_events of the most recent events, oldest first
+  size_t get_events(TraceEvent *events, size_t max_events) const;
+  void reset();
+
+ protected:
+  uint32_t samples_[TRACE_STAGE_COUNT][SAMPLES_PER_STAGE]{};
+  std::atomic<uint32_t> sample_counts_[TRACE_STAGE_COUNT]{};
+  TraceEvent events_[EVENT_COUNT]{};
+  std::atomic<uint32_t> event_count_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
+
+// Timestamps a point in the pipeline; paired with USB_TRACE_RECORD
+#define USB_TRACE_MARK(name) const uint32_t name = micros()
+#define USB_TRACE_RECORD(trace, stage, start) \
+  do { \
+    uint32_t trace_now_ = micros(); \
+    (trace).record(stage, trace_now_ - (start), trace_now_); \
+  } while (0)
+#define USB_TRACE_RECORD_LATENCY(trace, stage, latency_us) (trace).record(stage, latency_us, micros())
+
+#else
+
+#define USB_TRACE_MARK(name)
+#define USB_TRACE_RECORD(trace, stage, start)
+#define USB_TRACE_RECORD_LATENCY(trace, stage, latency_us)
+
+#endif  // USE_USB_COMMUNICATION_TRACE
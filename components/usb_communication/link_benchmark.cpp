@@ -0,0 +1,72 @@
+#include "link_benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+void LinkBenchmark::start(Mode mode, uint32_t target) {
+  *this = LinkBenchmark();
+  this->mode_ = mode;
+  this->target_ = target;
+}
+
+void LinkBenchmark::mark_activity_(uint32_t now_us) {
+  if (!this->started_) {
+    this->started_ = true;
+    this->first_us_ = now_us;
+  }
+  this->last_us_ = now_us;
+}
+
+void LinkBenchmark::record_bytes(size_t bytes, uint32_t now_us) {
+  this->mark_activity_(now_us);
+  this->progress_ += bytes;
+  this->frames_++;
+}
+
+void LinkBenchmark::record_rtt(uint32_t rtt_us, uint32_t now_us) {
+  this->mark_activity_(now_us);
+  this->progress_++;
+  this->frames_++;
+  this->rtt_min_us_ = this->rtt_count_ == 0 ? rtt_us : std::min(this->rtt_min_us_, rtt_us);
+  this->rtt_max_us_ = std::max(this->rtt_max_us_, rtt_us);
+  this->rtt_total_us_ += rtt_us;
+  this->rtt_count_++;
+
+  size_t bucket = 0;
+  while (bucket < RTT_BUCKET_COUNT - 1 && rtt_us >= (RTT_FIRST_BUCKET_US << bucket)) {
+    bucket++;
+  }
+  this->rtt_histogram_[bucket]++;
+}
+
+void LinkBenchmark::record_lost() {
+  this->progress_++;
+  this->lost_++;
+}
+
+size_t LinkBenchmark::fill_source_payload(uint8_t *payload, size_t max_length) {
+  if (max_length <= sizeof(uint32_t) || this->generated_ >= this->target_) {
+    return 0;
+  }
+  size_t length = std::min<size_t>(max_length - sizeof(uint32_t), this->target_ - this->generated_);
+  memcpy(payload, &this->generated_, sizeof(uint32_t));
+  for (size_t i = 0; i < length; i++) {
+    payload[sizeof(uint32_t) + i] = source_pattern_byte(this->generated_ + i);
+  }
+  this->generated_ += length;
+  return sizeof(uint32_t) + length;
+}
+
+uint32_t LinkBenchmark::bytes_per_second() const {
+  uint32_t duration = this->duration_us();
+  if (duration == 0 || this->mode_ == MODE_RTT) {
+    return 0;
+  }
+  return static_cast<uint64_t>(this->progress_) * 1000000 / duration;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Device-side measurement of the USB link for soak testing. One run is active at a time:
+//   sink    the host sends FRAME_TYPE_BENCH_SINK frames, which are counted and discarded
+//   source  the device streams FRAME_TYPE_BENCH_SOURCE frames of generated data to the host
+//   rtt     the device sends FRAME_TYPE_BENCH_PING frames that the host returns unchanged
+// Throughput is timed from the first byte of the run, so host start-up delay does not count against the link.
+class LinkBenchmark {
+ public:
+  enum Mode : uint8_t {
+    MODE_IDLE,
+    MODE_SINK,
+    MODE_SOURCE,
+    MODE_RTT,
+  };
+
+  // Bucket i counts round trips below RTT_FIRST_BUCKET_US << i; the last bucket also takes everything slower
+  static const size_t RTT_BUCKET_COUNT = 12;
+  static const uint32_t RTT_FIRST_BUCKET_US = 128;
+
+  // target is in bytes for sink and source, in pings for rtt
+  void start(Mode mode, uint32_t target);
+  void stop() { this->mode_ = MODE_IDLE; }
+  Mode mode() const { return this->mode_; }
+  bool done() const { return this->progress_ >= this->target_; }
+  bool generated() const { return this->generated_ >= this->target_; }
+  uint32_t progress() const { return this->progress_; }
+  uint32_t target() const { return this->target_; }
+
+  void record_bytes(size_t bytes, uint32_t now_us);
+  void record_rtt(uint32_t rtt_us, uint32_t now_us);
+  void record_lost();
+  // Stamps the end of a source run once its last frame has left the TX queue
+  void finish(uint32_t now_us) { this->last_us_ = now_us; }
+
+  // Source payloads are a uint32 stream offset followed by source_pattern_byte(offset + i), so the host can check
+  // both order and content. Returns the payload length, 0 once the target has been generated.
+  size_t fill_source_payload(uint8_t *payload, size_t max_length);
+
+  uint32_t frames() const { return this->frames_; }
+  uint32_t lost() const { return this->lost_; }
+  uint32_t duration_us() const { return this->last_us_ - this->first_us_; }
+  uint32_t bytes_per_second() const;
+  uint32_t rtt_min_us() const { return this->rtt_count_ > 0 ? this->rtt_min_us_ : 0; }
+  uint32_t rtt_max_us() const { return this->rtt_max_us_; }
+  uint32_t rtt_mean_us() const { return this->rtt_count_ > 0 ? this->rtt_total_us_ / this->rtt_count_ : 0; }
+  const uint32_t *rtt_histogram() const { return this->rtt_histogram_; }
+
+ protected:
+  void mark_activity_(uint32_t now_us);
+
+  Mode mode_{MODE_IDLE};
+  uint32_t target_{0};
+  uint32_t progress_{0};
+  uint32_t generated_{0};
+  uint32_t frames_{0};
+  uint32_t lost_{0};
+  bool started_{false};
+  uint32_t first_us_{0};
+  uint32_t last_us_{0};
+  uint32_t rtt_count_{0};
+  uint32_t rtt_min_us_{0};
+  uint32_t rtt_max_us_{0};
+  uint64_t rtt_total_us_{0};
+  uint32_t rtt_histogram_[RTT_BUCKET_COUNT]{};
+};
+
+inline uint8_t source_pattern_byte(uint32_t offset) { return static_cast<uint8_t>(offset ^ (offset >> 8)); }
+
+}  // namespace usb_communication
+}  // namespace esphome
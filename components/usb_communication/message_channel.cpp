@@ -0,0 +1,34 @@
+#include "message_channel.h"
+
+namespace esphome {
+namespace usb_communication {
+
+bool MessageChannel::push(const uint8_t *data, size_t length, const uint8_t *extra, size_t extra_length) {
+  size_t total = length + extra_length;
+  if (total == 0 || total > this->max_message_ || total > UINT16_MAX || this->ring_.free() < sizeof(uint16_t) + total) {
+    this->dropped_++;
+    return false;
+  }
+  uint16_t header = total;
+  this->ring_.stage(0, reinterpret_cast<const uint8_t *>(&header), sizeof(header));
+  this->ring_.stage(sizeof(header), data, length);
+  this->ring_.stage(sizeof(header) + length, extra, extra_length);
+  this->ring_.commit(sizeof(header) + total);
+  return true;
+}
+
+size_t MessageChannel::pop(uint8_t *buffer, size_t buffer_size) {
+  // Messages are published whole, so a visible length means the whole message is there
+  uint16_t length;
+  while (this->ring_.available() >= sizeof(length)) {
+    this->ring_.read(reinterpret_cast<uint8_t *>(&length), sizeof(length));
+    if (length <= buffer_size) {
+      return this->ring_.read(buffer, length);
+    }
+    this->ring_.consume(length);
+  }
+  return 0;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
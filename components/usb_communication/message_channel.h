@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "spsc_ring_buffer.h"
+
+namespace esphome {
+namespace usb_communication {
+
+// Lock-free queue of variable-length messages between exactly one producer task and one consumer task.
+//
+// Each message is a 16-bit length followed by its bytes in an SPSCRingBuffer, published with a single commit so
+// the consumer only ever sees whole messages. Messages are limited to max_message bytes, the size of the consumer's
+// buffer, so push() refuses anything the other side could not take.
+class MessageChannel {
+ public:
+  bool init(uint8_t *storage, size_t capacity, size_t max_message) {
+    this->max_message_ = max_message;
+    return this->ring_.init(storage, capacity);
+  }
+
+  // Queues data followed by extra as one message; returns false (queuing nothing) if it is longer than
+  // max_message() or does not fit
+  bool push(const uint8_t *data, size_t length, const uint8_t *extra = nullptr, size_t extra_length = 0);
+
+  // Copies the oldest message into buffer and returns its length, or 0 if the channel is empty. Messages longer than
+  // buffer_size are discarded and the next one is returned instead.
+  size_t pop(uint8_t *buffer, size_t buffer_size);
+
+  size_t max_message() const { return this->max_message_; }
+  // Messages push() refused; only the producer may read this
+  uint32_t dropped() const { return this->dropped_; }
+
+ protected:
+  SPSCRingBuffer<uint8_t> ring_;
+  size_t max_message_{0};
+  uint32_t dropped_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,36 @@
+#include "preroll_buffer.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+bool PrerollBuffer::init(int16_t *storage, size_t capacity) {
+  if (storage == nullptr || capacity == 0) {
+    return false;
+  }
+  this->storage_ = storage;
+  this->capacity_ = capacity;
+  this->position_ = 0;
+  this->filled_ = 0;
+  return true;
+}
+
+void PrerollBuffer::write(const int16_t *samples, size_t count) {
+  if (this->capacity_ == 0) {
+    return;
+  }
+  // Only the newest capacity_ samples can survive
+  if (count > this->capacity_) {
+    samples += count - this->capacity_;
+    count = this->capacity_;
+  }
+  size_t first = count < this->capacity_ - this->position_ ? count : this->capacity_ - this->position_;
+  memcpy(this->storage_ + this->position_, samples, first * sizeof(int16_t));
+  memcpy(this->storage_, samples + first, (count - first) * sizeof(int16_t));
+  this->position_ = (this->position_ + count) % this->capacity_;
+  this->filled_ = this->filled_ + count < this->capacity_ ? this->filled_ + count : this->capacity_;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
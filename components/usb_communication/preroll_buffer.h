@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// History of the most recent mono microphone samples, so an uplink can start with the audio from before its trigger.
+//
+// Unlike SPSCRingBuffer it never refuses a write: the oldest samples are overwritten. It is only used from the
+// microphone task, which both fills it and copies it out, so it needs no synchronisation.
+class PrerollBuffer {
+ public:
+  // Storage is owned by the caller and must hold `capacity` samples
+  bool init(int16_t *storage, size_t capacity);
+
+  size_t capacity() const { return this->capacity_; }
+  size_t available() const { return this->filled_; }
+  void clear() { this->filled_ = 0; }
+
+  void write(const int16_t *samples, size_t count);
+
+  // Hands the buffered history to visit(const int16_t *samples, size_t count), oldest first, in at most two pieces
+  template<typename F> void for_each_span(F &&visit) const {
+    if (this->filled_ == 0) {
+      return;
+    }
+    size_t start = (this->position_ + this->capacity_ - this->filled_) % this->capacity_;
+    size_t first = this->filled_ < this->capacity_ - start ? this->filled_ : this->capacity_ - start;
+    visit(this->storage_ + start, first);
+    if (this->filled_ > first) {
+      visit(this->storage_, this->filled_ - first);
+    }
+  }
+
+ protected:
+  int16_t *storage_{nullptr};
+  size_t capacity_{0};
+  size_t position_{0};  // next sample to write
+  size_t filled_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
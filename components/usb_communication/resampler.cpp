@@ -0,0 +1,109 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+namespace {
+
+uint32_t gcd(uint32_t a, uint32_t b) {
+  while (b != 0) {
+    uint32_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+}  // namespace
+
+bool Resampler::configure(uint32_t input_rate, uint32_t output_rate) {
+  if (this->coefficients_ == nullptr || input_rate == 0 || output_rate == 0) {
+    return false;
+  }
+  uint32_t divisor = gcd(input_rate, output_rate);
+  uint32_t interpolation = output_rate / divisor;
+  uint32_t decimation = input_rate / divisor;
+  if (interpolation > MAX_PHASES || (interpolation + decimation - 1) / decimation > MAX_OUTPUTS_PER_INPUT) {
+    return false;
+  }
+  if (this->built_ && interpolation == this->interpolation_ && decimation == this->decimation_) {
+    this->reset();
+    return true;
+  }
+  this->interpolation_ = interpolation;
+  this->decimation_ = decimation;
+
+  // Prototype low-pass at interpolation * input_rate, cut off just below the lower of the two Nyquist rates
+  const size_t length = interpolation * TAPS;
+  const double cutoff = 0.45 / std::max(interpolation, decimation);  // cycles per prototype sample
+  const double center = (length - 1) / 2.0;
+
+  // Phase p uses prototype taps p, p + L, p + 2L, ...; stored reversed so index 0 multiplies the newest sample
+  for (uint32_t phase = 0; phase < interpolation; phase++) {
+    double taps[TAPS];
+    double sum = 0.0;
+    for (size_t k = 0; k < TAPS; k++) {
+      size_t n = phase + k * interpolation;
+      double t = n - center;
+      double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+      // Blackman window
+      double x = static_cast<double>(n) / (length - 1);
+      double window = 0.42 - 0.5 * std::cos(2.0 * M_PI * x) + 0.08 * std::cos(4.0 * M_PI * x);
+      taps[k] = sinc * window;
+      sum += taps[k];
+    }
+    for (size_t k = 0; k < TAPS; k++) {
+      double value = std::min(32767.0, std::max(-32768.0, taps[k] / sum * 16384.0));
+      this->coefficients_[phase * TAPS + k] = static_cast<int16_t>(std::lround(value));
+    }
+  }
+  this->built_ = true;
+
+  this->reset();
+  return true;
+}
+
+void Resampler::reset() {
+  memset(this->history_, 0, sizeof(this->history_));
+  this->history_position_ = 0;
+  this->phase_ = 0;
+}
+
+size_t Resampler::process(const int16_t *input, size_t input_count, int16_t *output, size_t output_capacity,
+                          size_t *consumed) {
+  const size_t outputs_per_input = (this->interpolation_ + this->decimation_ - 1) / this->decimation_;
+  size_t produced = 0;
+  size_t used = 0;
+
+  // Only take an input sample when every output it can produce fits
+  while (used < input_count && output_capacity - produced >= outputs_per_input) {
+    // Newest sample goes in front of the window; the mirrored copy keeps history_[pos..pos+TAPS) contiguous
+    this->history_position_ = this->history_position_ == 0 ? TAPS - 1 : this->history_position_ - 1;
+    this->history_[this->history_position_] = input[used];
+    this->history_[this->history_position_ + TAPS] = input[used];
+    used++;
+
+    const int16_t *window = this->history_ + this->history_position_;
+    while (this->phase_ < this->interpolation_) {
+      const int16_t *taps = this->coefficients_ + this->phase_ * TAPS;
+      int32_t accumulator = 1 << 13;  // rounding for the Q14 coefficients
+      for (size_t k = 0; k < TAPS; k++) {
+        accumulator += static_cast<int32_t>(taps[k]) * window[k];
+      }
+      accumulator >>= 14;
+      output[produced++] = static_cast<int16_t>(std::max(-32768, std::min(32767, accumulator)));
+      this->phase_ += this->decimation_;
+    }
+    this->phase_ -= this->interpolation_;
+  }
+
+  *consumed = used;
+  return produced;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Fixed-point polyphase resampler for 16-bit mono audio.
+//
+// The rate ratio is reduced to L/M (output/input). A windowed-sinc low-pass prototype designed at L times the input
+// rate is split into L phases of TAPS coefficients each (Q14, each phase normalised to unity DC gain); every output
+// sample is then one TAPS-long dot product against the input history. The table lives in storage handed to init()
+// and is only rebuilt when configure() is given a new ratio, so the per-sample path is integer only and starting a
+// stream at the same rate costs nothing.
+class Resampler {
+ public:
+  static const size_t TAPS = 24;
+  static const uint32_t MAX_PHASES = 640;
+  // Largest upsampling factor; 8 kHz to 48 kHz needs 6
+  static const uint32_t MAX_OUTPUTS_PER_INPUT = 8;
+  // Size of the coefficient storage, enough for any ratio configure() accepts
+  static const size_t COEFFICIENT_COUNT = MAX_PHASES * TAPS;
+
+  // Uses `coefficients` (COEFFICIENT_COUNT entries) for the filter table
+  void init(int16_t *coefficients) {
+    this->coefficients_ = coefficients;
+    this->built_ = false;
+  }
+
+  // Returns false without storage, or if the ratio needs more than MAX_PHASES phases or upsamples by more than
+  // MAX_OUTPUTS_PER_INPUT. Resets the stream state on success.
+  bool configure(uint32_t input_rate, uint32_t output_rate);
+  void reset();
+
+  // Resamples as much of `input` as fits into `output`. Returns the number of samples written and stores the number
+  // of input samples used in `consumed`. Nothing is consumed unless output_capacity is at least
+  // MAX_OUTPUTS_PER_INPUT.
+  size_t process(const int16_t *input, size_t input_count, int16_t *output, size_t output_capacity, size_t *consumed);
+
+  // Upper bound on the output produced for input_count input samples
+  size_t max_output(size_t input_count) const {
+    return (input_count * this->interpolation_ + this->decimation_ - 1) / this->decimation_ + 1;
+  }
+
+  uint32_t interpolation() const { return this->interpolation_; }
+  uint32_t decimation() const { return this->decimation_; }
+
+ protected:
+  int16_t *coefficients_{nullptr};  // interpolation_ phases of TAPS coefficients, newest sample first
+  bool built_{false};               // coefficients_ holds the table for interpolation_ / decimation_
+  int16_t history_[2 * TAPS]{};     // the last TAPS inputs, stored twice so a window is always contiguous
+  size_t history_position_{0};
+  uint32_t interpolation_{1};
+  uint32_t decimation_{1};
+  uint32_t phase_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+// Fixed-capacity, lock-free ring for exactly one producer task and one consumer task.
+//
+// head_ is only written by the producer and tail_ only by the consumer; both are free-running counters masked on
+// access, so the capacity must be a power of two. Writes that do not fit are dropped (never blocking the producer)
+// and counted in dropped(). The consumer may discard old data with consume() to get at the most recent samples.
+template<typename T> class SPSCRingBuffer {
+ public:
+  // Storage is owned by the caller and must hold `capacity` elements; capacity must be a power of two
+  bool init(T *storage, size_t capacity) {
+    if (storage == nullptr || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+      return false;
+    }
+    this->storage_ = storage;
+    this->capacity_ = capacity;
+    this->head_.store(0, std::memory_order_relaxed);
+    this->tail_.store(0, std::memory_order_relaxed);
+    this->dropped_.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  size_t capacity() const { return this->capacity_; }
+  uint32_t dropped() const { return this->dropped_.load(std::memory_order_relaxed); }
+
+  // Producer side
+
+  size_t free() const {
+    size_t used = this->head_.load(std::memory_order_relaxed) - this->tail_.load(std::memory_order_acquire);
+    return this->capacity_ - used;
+  }
+
+  // Returns a pointer to the contiguous writable region and its length; fill it, then commit()
+  size_t peek_write(T **data) {
+    size_t head = this->head_.load(std::memory_order_relaxed);
+    size_t offset = head & (this->capacity_ - 1);
+    *data = this->storage_ + offset;
+    return std::min(this->free(), this->capacity_ - offset);
+  }
+
+  void commit(size_t count) {
+    this->head_.store(this->head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  // Copies count elements to `offset` elements past the write position without publishing them, so several pieces
+  // can become visible to the consumer at once with a single commit(). The caller checks free() beforehand.
+  void stage(size_t offset, const T *data, size_t count) {
+    if (count == 0) {
+      return;
+    }
+    size_t start = (this->head_.load(std::memory_order_relaxed) + offset) & (this->capacity_ - 1);
+    size_t first = std::min(count, this->capacity_ - start);
+    memcpy(this->storage_ + start, data, first * sizeof(T));
+    memcpy(this->storage_, data + first, (count - first) * sizeof(T));
+  }
+
+  // Copies as much as fits; the remainder is dropped and counted
+  size_t write(const T *data, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+      T *region;
+      size_t length = std::min(this->peek_write(&region), count - written);
+      if (length == 0) {
+        break;
+      }
+      memcpy(region, data + written, length * sizeof(T));
+      this->commit(length);
+      written += length;
+    }
+    if (written < count) {
+      this->dropped_.fetch_add(count - written, std::memory_order_relaxed);
+    }
+    return written;
+  }
+
+  // Consumer side
+
+  size_t available() const {
+    return this->head_.load(std::memory_order_acquire) - this->tail_.load(std::memory_order_relaxed);
+  }
+
+  // Returns a pointer to the contiguous readable region and its length; use it in place, then consume()
+  size_t peek(const T **data) const {
+    size_t tail = this->tail_.load(std::memory_order_relaxed);
+    size_t offset = tail & (this->capacity_ - 1);
+    *data = this->storage_ + offset;
+    return std::min(this->available(), this->capacity_ - offset);
+  }
+
+  void consume(size_t count) {
+    count = std::min(count, this->available());
+    this->tail_.store(this->tail_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+  }
+
+  size_t read(T *data, size_t count) {
+    size_t copied = 0;
+    while (copied < count) {
+      const T *region;
+      size_t length = std::min(this->peek(&region), count - copied);
+      if (length == 0) {
+        break;
+      }
+      memcpy(data + copied, region, length * sizeof(T));
+      this->consume(length);
+      copied += length;
+    }
+    return copied;
+  }
+
+ protected:
+  T *storage_{nullptr};
+  size_t capacity_{0};
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
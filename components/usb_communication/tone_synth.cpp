@@ -0,0 +1,126 @@
+#include "tone_synth.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+// sin(pi/2 * i / 64) in Q15
+static const int16_t QUARTER_SINE[65] = {
+    0,     804,   1608,  2410,  3212,  4011,  4808,  5602,  6393,  7179,  7962,  8739,  9512,
+    10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868,
+    19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811, 25329, 25832, 26319,
+    26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956, 30273, 30571, 30852, 31113,
+    31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757, 32767,
+};
+
+// Top two phase bits select the quadrant, the next six the table entry and the next eight interpolate
+static inline int32_t sine_q15(uint32_t phase) {
+  uint32_t quadrant = phase >> 30;
+  uint32_t index = (phase >> 24) & 0x3F;
+  int32_t fraction = (phase >> 16) & 0xFF;
+  if (quadrant & 1) {
+    // Mirrored quadrant: walk the table backwards
+    index = 63 - index;
+    fraction = 255 - fraction;
+  }
+  int32_t a = QUARTER_SINE[index];
+  int32_t b = QUARTER_SINE[index + 1];
+  int32_t value = a + (((b - a) * fraction) >> 8);
+  return (quadrant & 2) ? -value : value;
+}
+
+bool ToneSynth::add_note(uint16_t frequency_hz, uint16_t duration_ms, uint16_t gap_ms) {
+  if (this->note_count_ >= MAX_NOTES) {
+    return false;
+  }
+  // Above Nyquist the note would alias; play it as a rest instead
+  uint32_t frequency = 2u * frequency_hz < this->sample_rate_ ? frequency_hz : 0;
+  Note &note = this->notes_[this->note_count_++];
+  note.phase_increment = static_cast<uint32_t>((static_cast<uint64_t>(frequency) << 32) / this->sample_rate_);
+  note.samples = static_cast<uint64_t>(duration_ms) * this->sample_rate_ / 1000;
+  note.gap_samples = static_cast<uint64_t>(gap_ms) * this->sample_rate_ / 1000;
+  if (this->note_count_ == 1) {
+    this->current_ = 0;
+    this->begin_note_();
+  }
+  return true;
+}
+
+void ToneSynth::clear() {
+  this->note_count_ = 0;
+  this->current_ = 0;
+}
+
+void ToneSynth::begin_note_() {
+  this->position_ = 0;
+  this->phase_ = 0;
+  const Note &note = this->notes_[this->current_];
+  // Short notes scale the envelope down so attack and release still fit
+  uint32_t attack = static_cast<uint64_t>(this->envelope_.attack_ms) * this->sample_rate_ / 1000;
+  uint32_t decay = static_cast<uint64_t>(this->envelope_.decay_ms) * this->sample_rate_ / 1000;
+  uint32_t release = static_cast<uint64_t>(this->envelope_.release_ms) * this->sample_rate_ / 1000;
+  uint32_t total = attack + decay + release;
+  if (total > note.samples && total > 0) {
+    attack = static_cast<uint64_t>(attack) * note.samples / total;
+    decay = static_cast<uint64_t>(decay) * note.samples / total;
+    release = static_cast<uint64_t>(release) * note.samples / total;
+  }
+  this->attack_samples_ = attack;
+  this->decay_samples_ = decay;
+  this->release_samples_ = release;
+}
+
+uint32_t ToneSynth::envelope_at_(uint32_t position) const {
+  // Products are 64-bit: envelope stages reach 65 s, far past where a Q15 level times a sample count fits 32 bits
+  const uint64_t full = 32767;
+  const Note &note = this->notes_[this->current_];
+  uint32_t level;
+  if (position < this->attack_samples_) {
+    level = full * position / this->attack_samples_;
+  } else if (position < this->attack_samples_ + this->decay_samples_) {
+    level = full - (full - this->envelope_.sustain) * (position - this->attack_samples_) / this->decay_samples_;
+  } else {
+    level = this->envelope_.sustain;
+  }
+  uint32_t remaining = note.samples - position;
+  if (remaining < this->release_samples_) {
+    level = static_cast<uint64_t>(level) * remaining / this->release_samples_;
+  }
+  return level;
+}
+
+size_t ToneSynth::render(int16_t *output, size_t max_samples) {
+  size_t produced = 0;
+  while (produced < max_samples && this->active()) {
+    const Note &note = this->notes_[this->current_];
+    if (this->position_ < note.samples) {
+      size_t count = std::min<size_t>(max_samples - produced, note.samples - this->position_);
+      const int32_t gain = this->amplitude_;
+      for (size_t i = 0; i < count; i++) {
+        int32_t level = static_cast<int32_t>((this->envelope_at_(this->position_) * gain) >> 15);
+        int32_t sample = note.phase_increment != 0 ? (sine_q15(this->phase_) * level) >> 15 : 0;
+        output[produced++] = static_cast<int16_t>(sample);
+        this->phase_ += note.phase_increment;
+        this->position_++;
+      }
+      continue;
+    }
+
+    size_t gap_left = note.gap_samples - (this->position_ - note.samples);
+    size_t count = std::min<size_t>(max_samples - produced, gap_left);
+    memset(output + produced, 0, count * sizeof(int16_t));
+    produced += count;
+    this->position_ += count;
+    if (count == gap_left) {
+      if (++this->current_ < this->note_count_) {
+        this->begin_note_();
+      }
+    }
+  }
+  return produced;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
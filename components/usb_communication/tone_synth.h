@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Sequenced sine tone generator for 16-bit mono audio.
+//
+// Each note is a 32-bit phase accumulator (an NCO) read through a quarter-wave sine table with linear interpolation,
+// shaped by an ADSR envelope. Samples are produced on demand, so a tone starts as soon as the first block is rendered
+// and never needs a buffer of its own. Everything on the per-sample path is integer math.
+class ToneSynth {
+ public:
+  static const size_t MAX_NOTES = 16;
+
+  struct Envelope {
+    uint16_t attack_ms{5};
+    uint16_t decay_ms{40};
+    uint16_t sustain{22938};  // Q15 level held between decay and release (0.7)
+    uint16_t release_ms{40};
+  };
+
+  void set_sample_rate(uint32_t sample_rate) { this->sample_rate_ = sample_rate; }
+  void set_envelope(const Envelope &envelope) { this->envelope_ = envelope; }
+  void set_amplitude(uint16_t amplitude) { this->amplitude_ = amplitude; }  // Q15
+
+  // Queues a note followed by gap_ms of silence; frequency 0 is a rest. Returns false once MAX_NOTES are queued.
+  bool add_note(uint16_t frequency_hz, uint16_t duration_ms, uint16_t gap_ms);
+  void clear();
+  bool active() const { return this->current_ < this->note_count_; }
+
+  // Renders up to max_samples samples, fewer only when the sequence ends; returns 0 once it has ended
+  size_t render(int16_t *output, size_t max_samples);
+
+ protected:
+  struct Note {
+    uint32_t phase_increment;
+    uint32_t samples;
+    uint32_t gap_samples;
+  };
+
+  void begin_note_();
+  uint32_t envelope_at_(uint32_t position) const;
+
+  Note notes_[MAX_NOTES];
+  size_t note_count_{0};
+  size_t current_{0};
+  uint32_t position_{0};  // samples into the current note, including its gap
+  uint32_t phase_{0};
+  uint32_t attack_samples_{0};
+  uint32_t decay_samples_{0};
+  uint32_t release_samples_{0};
+  uint32_t sample_rate_{16000};
+  Envelope envelope_;
+  uint16_t amplitude_{16384};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
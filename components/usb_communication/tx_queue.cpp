@@ -0,0 +1,123 @@
+#include "tx_queue.h"
+
+#include <cstring>
+
+#include "driver/usb_serial_jtag.h"
+
+namespace esphome {
+namespace usb_communication {
+
+void TxQueue::init(Priority priority, uint8_t *storage, size_t size) {
+  Lane &lane = this->lanes_[priority];
+  lane = Lane{};
+  lane.storage = storage;
+  lane.size = size;
+  lane.wrap = size;
+}
+
+bool TxQueue::push(Priority priority, const uint8_t *data, size_t length, const uint8_t *extra,
+                   size_t extra_length) {
+  Lane &lane = this->lanes_[priority];
+  size_t total = length + extra_length;
+  uint8_t *destination = total <= UINT16_MAX ? this->reserve_(lane, total) : nullptr;
+  if (destination == nullptr) {
+    lane.dropped++;
+    return false;
+  }
+  memcpy(destination, data, length);
+  if (extra_length > 0) {
+    memcpy(destination + length, extra, extra_length);
+  }
+  lane.lengths[(lane.length_head + lane.length_count) % MAX_MESSAGES] = total;
+  lane.length_count++;
+  return true;
+}
+
+uint8_t *TxQueue::reserve_(Lane &lane, size_t length) {
+  if (lane.storage == nullptr || length == 0 || lane.length_count == MAX_MESSAGES) {
+    return nullptr;
+  }
+  if (lane.used == 0) {
+    lane.head = lane.tail = 0;
+    lane.wrap = lane.size;
+    lane.wrapped = false;
+  }
+
+  size_t offset;
+  if (lane.wrapped) {
+    // Free space is the gap between the newest and the oldest message
+    if (length > lane.tail - lane.head) {
+      return nullptr;
+    }
+    offset = lane.head;
+  } else if (length <= lane.size - lane.head) {
+    offset = lane.head;
+  } else if (length <= lane.tail) {
+    // Messages never straddle the end; the unused tail space is skipped until the reader gets there
+    lane.wrap = lane.head;
+    lane.wrapped = true;
+    offset = 0;
+  } else {
+    return nullptr;
+  }
+
+  lane.head = offset + length;
+  lane.used += length;
+  return lane.storage + offset;
+}
+
+size_t TxQueue::flush() {
+  size_t written = 0;
+  while (true) {
+    Lane &control = this->lanes_[PRIORITY_CONTROL];
+    Lane &bulk = this->lanes_[PRIORITY_BULK];
+    size_t sent;
+    if (control.length_count > 0) {
+      sent = this->flush_lane_(control, MAX_COALESCE);
+    } else if (bulk.length_count > 0) {
+      sent = this->flush_lane_(bulk, 0);
+    } else {
+      break;
+    }
+    if (sent == 0) {
+      // Driver buffer full; lower priority data must not overtake what is waiting
+      break;
+    }
+    written += sent;
+  }
+  return written;
+}
+
+size_t TxQueue::flush_lane_(Lane &lane, size_t limit) {
+  if (lane.wrapped && lane.tail == lane.wrap) {
+    lane.tail = 0;
+    lane.wrap = lane.size;
+    lane.wrapped = false;
+  }
+
+  // Gather consecutive messages up to the limit (always at least one) without crossing the wrap point
+  size_t end = lane.wrapped ? lane.wrap : lane.head;
+  size_t length = 0;
+  uint8_t messages = 0;
+  while (messages < lane.length_count) {
+    size_t next = lane.lengths[(lane.length_head + messages) % MAX_MESSAGES];
+    if (messages > 0 && (length + next > limit || lane.tail + length + next > end)) {
+      break;
+    }
+    length += next;
+    messages++;
+  }
+
+  if (usb_serial_jtag_write_bytes(lane.storage + lane.tail, length, 0) <= 0) {
+    return 0;
+  }
+
+  lane.tail += length;
+  lane.used -= length;
+  lane.length_head = (lane.length_head + messages) % MAX_MESSAGES;
+  lane.length_count -= messages;
+  return length;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
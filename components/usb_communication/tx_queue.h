@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Outbound message queue for the USB Serial/JTAG link.
+//
+// Messages are queued whole into one of two lanes and handed to the driver from loop() without blocking. The
+// control lane (JSON responses, acks, credits) always drains before the bulk lane (microphone frames), which goes
+// one message at a time so a newly queued ack waits for at most one frame. Each message is stored contiguously, so
+// consecutive control messages are coalesced into a single driver write.
+//
+// usb_serial_jtag_write_bytes() either queues a whole buffer or nothing, so every message reaches the wire in one
+// piece and console output from other tasks can only land between messages, never inside a frame.
+class TxQueue {
+ public:
+  enum Priority : uint8_t {
+    PRIORITY_CONTROL,
+    PRIORITY_BULK,
+    PRIORITY_COUNT,
+  };
+
+  // Storage is owned by the caller
+  void init(Priority priority, uint8_t *storage, size_t size);
+
+  // Queues data followed by extra as one message; if it does not fit nothing is queued and the drop is counted
+  bool push(Priority priority, const uint8_t *data, size_t length, const uint8_t *extra = nullptr,
+            size_t extra_length = 0);
+
+  // Writes as many queued messages as the driver accepts right now; returns the number of bytes written
+  size_t flush();
+
+  size_t pending(Priority priority) const { return this->lanes_[priority].used; }
+  uint32_t dropped(Priority priority) const { return this->lanes_[priority].dropped; }
+
+  static const size_t MAX_COALESCE = 2048;
+
+ protected:
+  static const size_t MAX_MESSAGES = 64;
+
+  struct Lane {
+    uint8_t *storage{nullptr};
+    size_t size{0};
+    size_t head{0};   // next write offset
+    size_t tail{0};   // offset of the oldest message
+    size_t wrap{0};   // end of valid data when the lane has wrapped
+    size_t used{0};
+    bool wrapped{false};
+    uint16_t lengths[MAX_MESSAGES];
+    uint8_t length_head{0};
+    uint8_t length_count{0};
+    uint32_t dropped{0};
+  };
+
+  uint8_t *reserve_(Lane &lane, size_t length);
+  size_t flush_lane_(Lane &lane, size_t limit);
+
+  Lane lanes_[PRIORITY_COUNT];
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
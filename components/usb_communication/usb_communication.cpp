@@ -2,10 +2,14 @@
 #include "esphome/core/log.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/application.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include "driver/usb_serial_jtag.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_vfs_usb_serial_jtag.h"
 
 namespace esphome {
 namespace usb_communication {
@@ -14,804 +18,2417 @@ static const char *const TAG = "usb_communication";
 
 void USBCommunicationComponent::setup() {
   ESP_LOGCONFIG(TAG, "Setting up USB Communication Component using USB Serial/JTAG");
-  
-  // Allocate USB audio buffer (16KB like voice assistant)
-  usb_audio_buffer_ = new uint8_t[USB_AUDIO_BUFFER_SIZE];
+
+  // The playback buffer and chunk scratch space share one arena, so long TTS buffers stay out of internal RAM
+  size_t arena_size =
+      playback_buffer_size_ + FRAME_MAX_PAYLOAD + TX_CONTROL_LANE_SIZE + TX_BULK_LANE_SIZE + max_line_length_;
+  if (use_task_) {
+    arena_size += 2 * TASK_CHANNEL_SIZE + 2 * TASK_MESSAGE_MAX + SPEAKER_FEED_SIZE;
+  }
+  // 16 kHz mono int16
+  arena_size += preroll_ms_ * 16 * sizeof(int16_t);
+  arena_size += clip_cache_size_;
+  arena_size += Resampler::COEFFICIENT_COUNT * sizeof(int16_t);
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  if (voice_kit_ != nullptr) {
+    arena_size += XMOS_UPDATE_RING_SIZE;
+  }
+#endif
+  if (!audio_arena_.init(arena_size, use_psram_)) {
+    ESP_LOGE(TAG, "Failed to allocate %zu byte audio arena", arena_size);
+    this->mark_failed();
+    return;
+  }
+  usb_audio_buffer_ = audio_arena_.allocate<uint8_t>(playback_buffer_size_);
+  chunk_bytes_ = audio_arena_.allocate<uint8_t>(FRAME_MAX_PAYLOAD);
+  if (preroll_ms_ > 0) {
+    preroll_.init(audio_arena_.allocate<int16_t>(preroll_ms_ * 16), preroll_ms_ * 16);
+  }
+  line_buffer_ = audio_arena_.allocate<char>(max_line_length_);
+  resampler_.init(audio_arena_.allocate<int16_t>(Resampler::COEFFICIENT_COUNT));
+  if (clip_cache_size_ > 0) {
+    clip_cache_.init(audio_arena_.allocate<uint8_t>(clip_cache_size_), clip_cache_size_);
+  }
+  tx_queue_.init(TxQueue::PRIORITY_CONTROL, audio_arena_.allocate<uint8_t>(TX_CONTROL_LANE_SIZE),
+                 TX_CONTROL_LANE_SIZE);
+  tx_queue_.init(TxQueue::PRIORITY_BULK, audio_arena_.allocate<uint8_t>(TX_BULK_LANE_SIZE), TX_BULK_LANE_SIZE);
   usb_audio_buffer_index_ = 0;
   usb_audio_buffer_size_ = 0;
   is_streaming_audio_ = false;
   target_speaker_ = nullptr;
-  source_microphone_ = nullptr;
   is_capturing_audio_ = false;
-  last_audio_injection_time_ = 0;
-  
-  ESP_LOGCONFIG(TAG, "USB Communication ready - allocated %d byte audio buffer", USB_AUDIO_BUFFER_SIZE);
+  injected_audio_buffer_.init(injected_audio_storage_, MAX_INJECTED_AUDIO_BUFFER_SIZE);
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  if (voice_kit_ != nullptr) {
+    xmos_update_ring_.init(audio_arena_.allocate<uint8_t>(XMOS_UPDATE_RING_SIZE), XMOS_UPDATE_RING_SIZE);
+    voice_kit_->add_on_state_callback(
+        [this](voice_kit::DFUAutomationState state, float progress, voice_kit::VoiceKitUpdaterStatus status) {
+          this->on_voice_kit_state_(state, progress, status);
+        });
+  }
+  if (voice_kit_ != nullptr && vnr_gate_enabled_) {
+    voice_kit_->set_vnr_threshold(vnr_gate_threshold_);
+    if (voice_kit_->get_register_poll_interval() == 0) {
+      voice_kit_->set_register_poll_interval(VNR_GATE_POLL_INTERVAL_MS);
+    }
+  }
+  if (voice_kit_ != nullptr) {
+    // Also feeds the auto uplink's channel choice, so it is registered with or without the gate
+    voice_kit_->add_on_vnr_callback([this](uint8_t vnr, bool above) {
+      if (!above) {
+        vnr_quiet_since_ms_ = millis();
+      }
+      vnr_voice_ = above;
+    });
+  }
+#endif
+
+  // Read the USB Serial/JTAG port through its driver so whole blocks can be pulled per loop() instead of one
+  // getchar() at a time. Protocol output bypasses stdout and goes through tx_queue_; stdout is routed through the
+  // same driver so console output can only appear between whole messages.
+  if (!usb_serial_jtag_is_driver_installed()) {
+    usb_serial_jtag_driver_config_t usb_config = USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT();
+    usb_config.rx_buffer_size = RX_RING_SIZE;
+    usb_config.tx_buffer_size = TX_DRIVER_BUFFER_SIZE;
+    if (usb_serial_jtag_driver_install(&usb_config) != ESP_OK) {
+      ESP_LOGE(TAG, "Failed to install USB Serial/JTAG driver");
+      this->mark_failed();
+      return;
+    }
+  }
+  esp_vfs_usb_serial_jtag_use_driver();
+  rx_window_start_ = millis();
+
+  // Sized for 16 kHz stereo int16 (64 bytes per millisecond), so mono captures get twice the history. It also has
+  // to take the whole pre-roll burst on top of live audio.
+  mic_ring_buffer_ = RingBuffer::create((mic_ring_ms_ + preroll_ms_) * 64);
+  if (mic_ring_buffer_ == nullptr) {
+    ESP_LOGE(TAG, "Failed to allocate microphone ring buffer");
+    this->mark_failed();
+    return;
+  }
+
+  ESP_LOGCONFIG(TAG, "USB Communication ready - allocated %zu byte audio buffer in %s", playback_buffer_size_,
+                audio_arena_.is_psram() ? "PSRAM" : "internal RAM");
   ESP_LOGCONFIG(TAG, "Speaker reference: %s", target_speaker_ ? "SET" : "NULL");
-  
+
   // Send a boot message to indicate component is ready
   this->send_response_("boot_complete");
+
+  if (use_task_) {
+    to_main_loop_.init(audio_arena_.allocate<uint8_t>(TASK_CHANNEL_SIZE), TASK_CHANNEL_SIZE, TASK_MESSAGE_MAX);
+    from_main_loop_.init(audio_arena_.allocate<uint8_t>(TASK_CHANNEL_SIZE), TASK_CHANNEL_SIZE, TASK_MESSAGE_MAX);
+    task_message_buffer_ = audio_arena_.allocate<uint8_t>(TASK_MESSAGE_MAX);
+    main_loop_message_buffer_ = audio_arena_.allocate<uint8_t>(TASK_MESSAGE_MAX);
+    main_loop_commands_.init(main_loop_command_storage_, TASK_COMMAND_QUEUE_SIZE);
+    speaker_feed_.init(audio_arena_.allocate<uint8_t>(SPEAKER_FEED_SIZE), SPEAKER_FEED_SIZE);
+    if (xTaskCreatePinnedToCore(pipeline_task_, "usb_comm", task_stack_size_, this, task_priority_,
+                                &pipeline_task_handle_, task_core_) != pdPASS) {
+      ESP_LOGE(TAG, "Failed to start USB pipeline task, running it from loop()");
+      pipeline_task_handle_ = nullptr;
+    }
+  }
+}
+
+void USBCommunicationComponent::dump_config() {
+  ESP_LOGCONFIG(TAG, "USB Communication:");
+  ESP_LOGCONFIG(TAG, "  RX ring: %zu bytes", RX_RING_SIZE);
+  ESP_LOGCONFIG(TAG, "  Max line length: %zu bytes", max_line_length_);
+  ESP_LOGCONFIG(TAG, "  Playback buffer: %zu bytes (%s)", playback_buffer_size_,
+                audio_arena_.is_psram() ? "PSRAM" : "internal RAM");
+  ESP_LOGCONFIG(TAG, "  Microphone ring: %u ms", (unsigned) mic_ring_ms_);
+  ESP_LOGCONFIG(TAG, "  Pre-roll: %u ms", (unsigned) preroll_ms_);
+  if (clip_cache_.capacity() > 0) {
+    ESP_LOGCONFIG(TAG, "  Clip cache: %zu bytes", clip_cache_.capacity());
+  }
+  ESP_LOGCONFIG(TAG, "  Default uplink: %s",
+                uplink_mode_ == UPLINK_STEREO ? "stereo" : uplink_mode_ == UPLINK_AUTO ? "auto" : "mono");
+  if (pipeline_task_handle_ != nullptr) {
+    ESP_LOGCONFIG(TAG, "  Pipeline task: core %u, priority %u, stack %u", task_core_, task_priority_,
+                  (unsigned) task_stack_size_);
+  }
+}
+
+void USBCommunicationComponent::loop() {
+  static bool boot_message_sent = false;
+
+  // Announce ourselves on the first loop(); setup runs ahead of voice_kit, so this no longer waits for the XMOS
+  if (!boot_message_sent) {
+    this->send_response_("boot_complete");
+    boot_message_sent = true;
+  }
+
+  if (pipeline_task_handle_ == nullptr) {
+    this->run_pipeline_();
+  } else {
+    // Work the pipeline task handed over: speaker control and control messages that touch other components
+    uint8_t command;
+    while (main_loop_commands_.read(&command, 1) == 1) {
+      this->run_main_loop_command_(command);
+    }
+    this->drain_speaker_feed_();
+    size_t length;
+    while ((length = to_main_loop_.pop(main_loop_message_buffer_, TASK_MESSAGE_MAX)) > 0) {
+      this->process_message_(
+          std::string_view(reinterpret_cast<const char *>(main_loop_message_buffer_), length));
+    }
+  }
+
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  if (xmos_update_active_) {
+    this->service_xmos_update_();
+  }
+  if (mic_uplink_active_ && capture_mode_ == UPLINK_STEREO) {
+    this->refresh_mic_stages_();
+  }
+#endif
+  this->dispatch_events_();
+
+  // Push whatever state changed during this iteration; full snapshots only go out on get_status
+  if (state_.dirty != 0) {
+    this->send_status_delta_();
+  }
+
+  // Everything queued this iteration goes out in as few driver writes as possible
+  if (pipeline_task_handle_ == nullptr) {
+    tx_queue_.flush();
+  }
+}
+
+void USBCommunicationComponent::pipeline_task_(void *param) {
+  auto *self = static_cast<USBCommunicationComponent *>(param);
+  while (true) {
+    self->run_pipeline_();
+
+    // Responses produced on the main loop join the TX queue here, the only place that writes to the port
+    size_t length;
+    while ((length = self->from_main_loop_.pop(self->task_message_buffer_, TASK_MESSAGE_MAX)) > 0) {
+      if (!self->tx_queue_.push(TxQueue::PRIORITY_CONTROL, self->task_message_buffer_, length)) {
+        ESP_LOGW(TAG, "TX queue full, dropping %zu byte message", length);
+      }
+    }
+    self->tx_queue_.flush();
+    vTaskDelay(1);
+  }
+}
+
+bool USBCommunicationComponent::on_pipeline_task_() const {
+  return pipeline_task_handle_ != nullptr && xTaskGetCurrentTaskHandle() == pipeline_task_handle_;
+}
+
+void USBCommunicationComponent::run_on_main_loop_(uint8_t command) {
+  if (!this->on_pipeline_task_()) {
+    this->run_main_loop_command_(command);
+  } else if (main_loop_commands_.write(&command, 1) != 1) {
+    ESP_LOGW(TAG, "Main loop command queue full, dropping command %u", command);
+  }
+}
+
+void USBCommunicationComponent::run_main_loop_command_(uint8_t command) {
+  switch (command) {
+    case COMMAND_SPEAKER_START:
+      // A new start supersedes a finish still waiting for the feed to drain
+      speaker_finish_pending_ = false;
+      if (target_speaker_ != nullptr) {
+        target_speaker_->start();
+      }
+      break;
+    case COMMAND_SPEAKER_FINISH:
+      if (speaker_feed_.available() > 0) {
+        speaker_finish_pending_ = true;
+      } else if (target_speaker_ != nullptr) {
+        target_speaker_->finish();
+      }
+      break;
+  }
+}
+
+void USBCommunicationComponent::run_pipeline_() {
+  unsigned long now = millis();
+
+  // Drain everything the host has sent, then dispatch every complete frame and line from this tick
+  this->fill_rx_ring_();
+  std::string_view line;
+  while (this->read_line_(&line)) {
+    this->process_message_(line);
+  }
+
+  if (now - rx_window_start_ >= 1000) {
+    rx_bytes_per_second_ = static_cast<uint64_t>(rx_bytes_window_) * 1000 / (now - rx_window_start_);
+    rx_bytes_window_ = 0;
+    rx_window_start_ = now;
+  }
+
+  if (mic_uplink_active_) {
+    this->send_microphone_frames_();
+  }
+
+  if (benchmark_.mode() != LinkBenchmark::MODE_IDLE) {
+    this->run_benchmark_();
+  }
+
+  // A cached clip plays by refilling the playback buffer from the cache
+  if (clip_play_slot_ != ClipCache::NO_CLIP) {
+    this->pump_clip_();
+  }
+
+  // Keep the speaker topped up without blocking the loop
+  if (playback_state_ == PLAYBACK_PLAYING || playback_state_ == PLAYBACK_DRAINING || tone_playing_) {
+    this->feed_speaker_();
+  }
+
+  // Grant the host the space the speaker just freed, or repeat the current grant in case it was lost
+  if (is_streaming_audio_ && clip_play_slot_ == ClipCache::NO_CLIP) {
+    uint32_t limit = this->credit_limit_();
+    if (limit - credit_sent_limit_ >= CREDIT_MIN_GRANT || now - last_credit_time_ >= CREDIT_INTERVAL_MS) {
+      this->send_credit_();
+    }
+  }
+}
+
+void USBCommunicationComponent::fill_rx_ring_() {
+  // Non-blocking reads straight into the free space of the ring; loop because the free space may wrap
+  while (rx_ring_head_ - rx_ring_tail_ < RX_RING_SIZE) {
+    size_t head = rx_ring_head_ & (RX_RING_SIZE - 1);
+    size_t free_space = RX_RING_SIZE - (rx_ring_head_ - rx_ring_tail_);
+    size_t contiguous = std::min(free_space, RX_RING_SIZE - head);
+    int bytes_read = usb_serial_jtag_read_bytes(rx_ring_ + head, contiguous, 0);
+    if (bytes_read <= 0) {
+      break;
+    }
+    rx_ring_head_ += bytes_read;
+    rx_bytes_total_ += bytes_read;
+    rx_bytes_window_ += bytes_read;
+#ifdef USE_USB_COMMUNICATION_TRACE
+    trace_rx_read_us_ = micros();
+#endif
+  }
+}
+
+bool USBCommunicationComponent::read_line_(std::string_view *line) {
+  // Drop a partial frame if the host stalled mid-frame, otherwise it would swallow the next messages as payload
+  if (frame_parser_.in_progress() && millis() - last_frame_byte_time_ > FRAME_BYTE_TIMEOUT_MS) {
+    ESP_LOGW(TAG, "Binary frame timed out, resynchronizing");
+    frame_parser_.reset();
+    rx_frame_errors_++;
+  }
+
+  while (rx_ring_tail_ != rx_ring_head_) {
+    uint8_t c = rx_ring_[rx_ring_tail_++ & (RX_RING_SIZE - 1)];
+
+    // Binary frames can only start between JSON lines; frames are dispatched as soon as they complete
+    if (frame_parser_.in_progress() || (line_length_ == 0 && !line_discarding_ && c == FRAME_MAGIC_0)) {
+      last_frame_byte_time_ = millis();
+      this->handle_frame_byte_(c);
+      continue;
+    }
+
+    if (c == '\n') {
+      line_discarding_ = false;
+      if (line_length_ > 0) {
+        // The view stays valid until the next call appends to the buffer again
+        *line = std::string_view(line_buffer_, line_length_);
+        line_length_ = 0;
+        ESP_LOGV(TAG, "Complete line received (%zu bytes)", line->size());
+        USB_TRACE_RECORD(trace_, TRACE_RX_DISPATCH, trace_rx_read_us_);
+        return true;
+      }
+    } else if (c != '\r' && !line_discarding_) {
+      if (line_length_ < max_line_length_) {
+        line_buffer_[line_length_++] = static_cast<char>(c);
+      } else {
+        // Dispatching what fits would hand the parser a truncated message, so drop the whole line
+        ESP_LOGW(TAG, "Line exceeds %zu bytes, discarding it", max_line_length_);
+        line_length_ = 0;
+        line_discarding_ = true;
+        rx_line_overflows_++;
+        this->send_line_overflow_();
+      }
+    }
+  }
+
+  return false;
+}
+
+bool USBCommunicationComponent::handle_frame_byte_(uint8_t byte) {
+  switch (frame_parser_.push(byte)) {
+    case FrameParser::NEED_MORE:
+      return false;
+    case FrameParser::FRAME_READY:
+      USB_TRACE_RECORD(trace_, TRACE_RX_DISPATCH, trace_rx_read_us_);
+      this->process_frame_(frame_parser_.header(), frame_parser_.payload());
+      return true;
+    case FrameParser::FRAME_BAD_MAGIC:
+      ESP_LOGW(TAG, "Invalid binary frame magic");
+      rx_frame_errors_++;
+      return true;
+    case FrameParser::FRAME_BAD_LENGTH:
+      ESP_LOGW(TAG, "Binary frame length %u exceeds %zu bytes", frame_parser_.header().length, FRAME_MAX_PAYLOAD);
+      rx_frame_errors_++;
+      this->send_frame_error_("length", frame_parser_.header().sequence);
+      return true;
+    case FrameParser::FRAME_BAD_CRC:
+      ESP_LOGW(TAG, "Binary frame %u failed CRC check", frame_parser_.header().sequence);
+      rx_frame_errors_++;
+      this->send_frame_error_("crc", frame_parser_.header().sequence);
+      return true;
+  }
+  return true;
+}
+
+void USBCommunicationComponent::process_frame_(const FrameHeader &header, const uint8_t *payload) {
+  // Track sequence gaps so the host can tell lost frames from CRC failures
+  uint16_t expected_sequence = rx_frame_sequence_ + 1;
+  if (rx_frame_count_ > 0 && header.sequence != expected_sequence) {
+    uint16_t lost = header.sequence - expected_sequence;
+    ESP_LOGW(TAG, "Binary frame sequence gap: expected %u, got %u", expected_sequence, header.sequence);
+    rx_frames_lost_ += lost;
+  }
+  rx_frame_sequence_ = header.sequence;
+  rx_frame_count_++;
+
+  switch (header.type) {
+    case FRAME_TYPE_AUDIO_DATA:
+      this->begin_audio_segment_(header.sequence);
+      if (stream_codec_ == AUDIO_CODEC_PCM_S16LE && header.length % sizeof(int16_t) != 0) {
+        ESP_LOGW(TAG, "Audio frame %u has odd length %u, dropping", header.sequence, header.length);
+        this->send_frame_error_("length", header.sequence);
+        break;
+      }
+      this->write_encoded_audio_(payload, header.length);
+      break;
+
+    case FRAME_TYPE_XMOS_FIRMWARE:
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+      if (xmos_update_active_) {
+        // A host that ignores its credit overruns the ring; loop() sees that in dropped() and aborts the update
+        xmos_update_ring_.write(payload, header.length);
+        break;
+      }
+#endif
+      ESP_LOGW(TAG, "XMOS firmware frame %u without an active update", header.sequence);
+      this->send_frame_error_("state", header.sequence);
+      break;
+
+    case FRAME_TYPE_CLIP_DATA:
+      this->receive_clip_data_(header, payload);
+      break;
+
+    case FRAME_TYPE_BENCH_ECHO:
+      this->send_frame_(FRAME_TYPE_BENCH_ECHO, payload, header.length);
+      break;
+
+    case FRAME_TYPE_BENCH_SINK:
+      if (benchmark_.mode() == LinkBenchmark::MODE_SINK) {
+        benchmark_.record_bytes(header.length, micros());
+      }
+      break;
+
+    case FRAME_TYPE_BENCH_PING: {
+      uint32_t id;
+      uint32_t sent_us;
+      if (benchmark_.mode() != LinkBenchmark::MODE_RTT || header.length < 2 * sizeof(uint32_t)) {
+        break;
+      }
+      memcpy(&id, payload, sizeof(uint32_t));
+      memcpy(&sent_us, payload + sizeof(uint32_t), sizeof(uint32_t));
+      // Late replies to pings already counted as lost are ignored
+      if (bench_ping_outstanding_ && id == bench_ping_id_ && sent_us == bench_ping_sent_us_) {
+        uint32_t now = micros();
+        benchmark_.record_rtt(now - sent_us, now);
+        bench_ping_outstanding_ = false;
+      }
+      break;
+    }
+
+    default:
+      ESP_LOGW(TAG, "Unknown binary frame type 0x%02X", header.type);
+      this->send_frame_error_("type", header.sequence);
+      break;
+  }
+}
+
+void USBCommunicationComponent::mark_usb_activity() {
+  // Function to be called from YAML to mark USB activity
+  // This will be implemented in the YAML lambda
+}
+
+namespace {
+
+template<typename T, size_t N> constexpr bool message_types_sorted(const T (&handlers)[N]) {
+  for (size_t i = 1; i < N; i++) {
+    if (!(handlers[i - 1].type < handlers[i].type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Samples parsed from decimal JSON arrays are batched before being written to the playback buffer
+static const size_t DECIMAL_SAMPLE_BLOCK = 128;
+
+}  // namespace
+
+const USBCommunicationComponent::MessageHandler *USBCommunicationComponent::find_message_handler_(
+    std::string_view type) {
+  // Sorted by type for binary search; checked at compile time
+  static constexpr MessageHandler HANDLERS[] = {
+      {"audio_data_chunk", &USBCommunicationComponent::process_audio_data_chunk_, false, true},
+      {"benchmark", &USBCommunicationComponent::process_benchmark_, false, false},
+      {"benchmark_mic_convert", &USBCommunicationComponent::process_benchmark_mic_convert_, false, false},
+      {"clip_upload_begin", &USBCommunicationComponent::process_clip_upload_begin_, false, false},
+      {"config", &USBCommunicationComponent::process_config_, true, false},
+      {"disconnect", &USBCommunicationComponent::process_disconnect_, true, false},
+      {"finish_audio_stream", &USBCommunicationComponent::process_finish_audio_stream_, false, true},
+#ifdef USE_USB_COMMUNICATION_TRACE
+      {"get_latency_stats", &USBCommunicationComponent::process_get_latency_stats_, false, false},
+#endif
+      {"get_status", &USBCommunicationComponent::process_get_status_, true, false},
+#ifdef USE_USB_COMMUNICATION_TRACE
+      {"get_trace", &USBCommunicationComponent::process_get_trace_, false, false},
+#endif
+      {"get_wake_word_options", &USBCommunicationComponent::process_get_wake_word_options_, true, false},
+      {"has_clip", &USBCommunicationComponent::process_has_clip_, false, false},
+      {"heartbeat", &USBCommunicationComponent::process_heartbeat_, false, false},
+      {"play_audio", &USBCommunicationComponent::process_play_audio_, false, true},
+      {"play_audio_chunk", &USBCommunicationComponent::process_play_audio_chunk_, false, true},
+      {"play_audio_compressed", &USBCommunicationComponent::process_play_audio_compressed_, false, true},
+      {"play_clip", &USBCommunicationComponent::process_play_clip_, false, true},
+      {"play_tone", &USBCommunicationComponent::process_play_tone_, false, true},
+      {"start_audio_stream", &USBCommunicationComponent::process_start_audio_stream_, false, true},
+      {"start_capture", &USBCommunicationComponent::process_start_capture_, true, true},
+      {"stop_capture", &USBCommunicationComponent::process_stop_capture_, true, false},
+      {"xmos_update_begin", &USBCommunicationComponent::process_xmos_update_begin_, true, false},
+  };
+  static_assert(message_types_sorted(HANDLERS), "message handlers must be sorted by type");
+
+  const MessageHandler *end = HANDLERS + sizeof(HANDLERS) / sizeof(HANDLERS[0]);
+  const MessageHandler *handler = std::lower_bound(
+      HANDLERS, end, type, [](const MessageHandler &entry, std::string_view key) { return entry.type < key; });
+  return (handler != end && handler->type == type) ? handler : nullptr;
+}
+
+void USBCommunicationComponent::process_message_(std::string_view message) {
+  // Update heartbeat timestamp - this will be accessed by YAML interval
+  last_message_time_ = millis();
+
+  ESP_LOGV(TAG, "Received message (%zu bytes): %.*s", message.size(), static_cast<int>(message.size()),
+           message.data());
+
+  // One pass over the message extracts every field; the type then selects the handler directly
+  USB_TRACE_MARK(parse_start);
+  JsonMessage json;
+  if (!json.parse(message)) {
+    ESP_LOGW(TAG, "Malformed message (%zu bytes)", message.size());
+    return;
+  }
+
+  std::string_view type = json.type();
+  const MessageHandler *handler = find_message_handler_(type);
+  if (handler == nullptr) {
+    ESP_LOGI(TAG, "Unknown message type: %.*s", static_cast<int>(type.size()), type.data());
+    return;
+  }
+  if (handler->needs_audio && !this->audio_ready_()) {
+    // Control messages are served from the first loop(); audio waits until the XMOS has booted
+    ESP_LOGD(TAG, "Audio not ready, rejecting %.*s message", static_cast<int>(type.size()), type.data());
+    this->send_json_("{\"type\":\"not_ready\",\"request\":\"" + std::string(type) + "\",\"timestamp\":" +
+                     std::to_string(millis()) + "}");
+    return;
+  }
+  if (handler->main_loop && this->on_pipeline_task_()) {
+    // Parsed again on the main loop; control messages are small and rare
+    if (message.size() > to_main_loop_.max_message()) {
+      ESP_LOGW(TAG, "%zu byte %.*s message is too long for the main loop, dropping", message.size(),
+               static_cast<int>(type.size()), type.data());
+    } else if (!to_main_loop_.push(reinterpret_cast<const uint8_t *>(message.data()), message.size())) {
+      ESP_LOGW(TAG, "Main loop channel full, dropping %.*s message", static_cast<int>(type.size()), type.data());
+    }
+    return;
+  }
+  ESP_LOGD(TAG, "Processing %.*s message", static_cast<int>(type.size()), type.data());
+  USB_TRACE_RECORD(trace_, TRACE_PARSE, parse_start);
+  (this->*(handler->handler))(json);
+}
+
+bool USBCommunicationComponent::audio_ready_() {
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  // The speaker and microphone are set up after voice_kit lets setup proceed, and the XMOS clocks their I2S bus
+  return voice_kit_ == nullptr || voice_kit_->can_proceed();
+#else
+  return true;
+#endif
+}
+
+void USBCommunicationComponent::process_heartbeat_(const JsonMessage &message) {
+  this->send_response_("heartbeat_ack");
+}
+
+void USBCommunicationComponent::process_get_status_(const JsonMessage &message) {
+  // The snapshot supersedes any pending delta and carries its version
+  state_.commit();
+  this->send_status_update_();
+}
+
+void USBCommunicationComponent::process_get_wake_word_options_(const JsonMessage &message) {
+  this->send_wake_word_options_();
+}
+
+void USBCommunicationComponent::process_disconnect_(const JsonMessage &message) {
+  // Handle explicit disconnection
+  last_message_time_ = 0;  // Force timeout
+}
+
+void USBCommunicationComponent::process_start_capture_(const JsonMessage &message) {
+  UplinkMode mode = uplink_mode_;
+  std::string_view requested = message.get_string("mode");
+  if (requested == "mono") {
+    mode = UPLINK_MONO;
+  } else if (requested == "stereo") {
+    mode = UPLINK_STEREO;
+  } else if (requested == "auto") {
+    mode = UPLINK_AUTO;
+  } else if (!requested.empty()) {
+    ESP_LOGW(TAG, "Unsupported uplink mode '%.*s'", static_cast<int>(requested.size()), requested.data());
+    this->send_json_("{\"type\":\"capture_error\",\"reason\":\"unsupported_mode\",\"timestamp\":" +
+                     std::to_string(millis()) + "}");
+    return;
+  }
+
+  if (!this->start_uplink_(mode, "host")) {
+    this->send_response_("capture_unavailable");
+  }
+}
+
+void USBCommunicationComponent::on_wake_word_detected() {
+  // Queued like any other response, so it cannot land inside a frame the pipeline task is writing
+  this->send_json_("{\"type\":\"wake_word_detected\",\"timestamp\":" + std::to_string(millis()) + "}");
+
+  // Only worth streaming if someone is listening; a host that starts capture later still gets the pre-roll
+  if (mic_uplink_active_ || last_message_time_ == 0 || millis() - last_message_time_ > HOST_IDLE_MS) {
+    return;
+  }
+  this->start_uplink_(uplink_mode_, "wake_word");
+}
+
+bool USBCommunicationComponent::start_uplink_(UplinkMode mode, const char *trigger) {
+  if (mic_uplink_active_ && capture_mode_ == mode) {
+    // Already streaming, e.g. started on the wake word: restarting would throw away the pre-roll burst
+    this->send_capture_started_(trigger);
+    return true;
+  }
+
+  // Set before the ring is reset so the mic task converts the new layout from the first captured block
+  capture_mode_ = mode;
+  channel_selector_.reset();
+  this->refresh_mic_stages_();
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  // The auto mode only switches channels while VNR reports speech, which needs the register poller running
+  if (mode == UPLINK_AUTO && voice_kit_ != nullptr && voice_kit_->get_register_poll_interval() == 0) {
+    voice_kit_->set_register_poll_interval(VNR_GATE_POLL_INTERVAL_MS);
+  }
+#endif
+  // The pre-roll is mono, so only a mono uplink can open with it
+  preroll_flush_pending_ = mode == UPLINK_MONO && preroll_.capacity() > 0;
+  this->start_microphone_capture();
+  mic_uplink_active_ = is_capturing_audio_.load();
+  if (!mic_uplink_active_) {
+    capture_mode_ = UPLINK_MONO;
+    preroll_flush_pending_ = false;
+    return false;
+  }
+  this->send_capture_started_(trigger);
+  return true;
+}
+
+void USBCommunicationComponent::send_capture_started_(const char *trigger) {
+  uint8_t mode = capture_mode_;
+  std::string response;
+  response.reserve(192);
+  response += "{\"type\":\"capture_started\",\"trigger\":\"";
+  response += trigger;
+  response += "\",\"mode\":\"";
+  response += mode == UPLINK_STEREO ? "stereo" : mode == UPLINK_AUTO ? "auto" : "mono";
+  response += "\",\"sample_rate\":16000,\"channels\":";
+  response += mode == UPLINK_STEREO ? "2" : "1";
+  response += ",\"stages\":[";
+  response += std::to_string(mic_stages_[0].load());
+  response += ",";
+  response += std::to_string(mic_stages_[1].load());
+  response += "],\"preroll_ms\":";
+  response += std::to_string(mode == UPLINK_MONO ? preroll_ms_ : 0);
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::refresh_mic_stages_() {
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  if (voice_kit_ != nullptr) {
+    mic_stages_[0] = voice_kit_->get_cached_pipeline_stage(voice_kit::MICROPHONE_CHANNEL_0);
+    mic_stages_[1] = voice_kit_->get_cached_pipeline_stage(voice_kit::MICROPHONE_CHANNEL_1);
+  }
+#endif
+}
+
+bool USBCommunicationComponent::uplink_voice_() const {
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  return vnr_voice_;
+#else
+  return true;
+#endif
+}
+
+void USBCommunicationComponent::process_stop_capture_(const JsonMessage &message) {
+  this->stop_microphone_capture();
+  this->send_response_("capture_stopped");
+}
+
+void USBCommunicationComponent::process_benchmark_(const JsonMessage &message) {
+  std::string_view mode = message.get_string("mode");
+  const char *error = nullptr;
+  if (mode == "stop") {
+    if (benchmark_.mode() != LinkBenchmark::MODE_IDLE) {
+      this->send_benchmark_report_(false);
+      benchmark_.stop();
+    } else {
+      this->send_response_("benchmark_stopped");
+    }
+    return;
+  }
+
+  if (benchmark_.mode() != LinkBenchmark::MODE_IDLE) {
+    error = "busy";
+  } else if (mode == "sink") {
+    benchmark_.start(LinkBenchmark::MODE_SINK, message.get_int<uint32_t>("bytes", 1024 * 1024));
+  } else if (mode == "source") {
+    bench_frame_size_ = std::max<size_t>(
+        std::min(message.get_int<size_t>("frame_size", 1024), BENCH_SOURCE_FRAME_MAX), 2 * sizeof(uint32_t));
+    benchmark_.start(LinkBenchmark::MODE_SOURCE, message.get_int<uint32_t>("bytes", 1024 * 1024));
+  } else if (mode == "rtt") {
+    bench_frame_size_ = std::max<size_t>(std::min(message.get_int<size_t>("size", 16), BENCH_PING_SIZE_MAX),
+                                         2 * sizeof(uint32_t));
+    bench_interval_ms_ = message.get_int<uint32_t>("interval_ms", 10);
+    bench_ping_outstanding_ = false;
+    benchmark_.start(LinkBenchmark::MODE_RTT, message.get_int<uint32_t>("count", 100));
+  } else {
+    error = "invalid";
+  }
+
+  std::string response;
+  response.reserve(96);
+  if (error != nullptr) {
+    response += "{\"type\":\"benchmark_error\",\"reason\":\"";
+    response += error;
+    response += "\"}";
+    this->send_json_(response);
+    return;
+  }
+  bench_start_frames_lost_ = rx_frames_lost_;
+  bench_start_frame_errors_ = rx_frame_errors_;
+  response += "{\"type\":\"benchmark_started\",\"mode\":\"";
+  response.append(mode.data(), mode.size());
+  response += "\",\"target\":";
+  response += std::to_string(benchmark_.target());
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::run_benchmark_() {
+  switch (benchmark_.mode()) {
+    case LinkBenchmark::MODE_SINK:
+      if (benchmark_.done()) {
+        this->send_benchmark_report_(true);
+        benchmark_.stop();
+      }
+      break;
+
+    case LinkBenchmark::MODE_SOURCE:
+      // Keep the bulk lane full; chunk_bytes_ is only used inside audio_data_chunk handling, which cannot overlap
+      while (!benchmark_.generated() &&
+             tx_queue_.pending(TxQueue::PRIORITY_BULK) + FRAME_HEADER_SIZE + bench_frame_size_ <= TX_BULK_LANE_SIZE) {
+        size_t length = benchmark_.fill_source_payload(chunk_bytes_, bench_frame_size_);
+        this->send_frame_(FRAME_TYPE_BENCH_SOURCE, chunk_bytes_, length);
+        benchmark_.record_bytes(length - sizeof(uint32_t), micros());
+      }
+      // Done once the last frame has been handed to the driver
+      if (benchmark_.generated() && tx_queue_.pending(TxQueue::PRIORITY_BULK) == 0) {
+        benchmark_.finish(micros());
+        this->send_benchmark_report_(true);
+        benchmark_.stop();
+      }
+      break;
+
+    case LinkBenchmark::MODE_RTT: {
+      uint32_t now = millis();
+      if (bench_ping_outstanding_ && now - bench_ping_sent_ms_ >= BENCH_PING_TIMEOUT_MS) {
+        benchmark_.record_lost();
+        bench_ping_outstanding_ = false;
+      }
+      if (benchmark_.done()) {
+        this->send_benchmark_report_(true);
+        benchmark_.stop();
+      } else if (!bench_ping_outstanding_ && now - bench_ping_sent_ms_ >= bench_interval_ms_) {
+        this->send_benchmark_ping_();
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void USBCommunicationComponent::send_benchmark_ping_() {
+  uint8_t payload[BENCH_PING_SIZE_MAX];
+  bench_ping_id_++;
+  bench_ping_sent_us_ = micros();
+  bench_ping_sent_ms_ = millis();
+  memcpy(payload, &bench_ping_id_, sizeof(uint32_t));
+  memcpy(payload + sizeof(uint32_t), &bench_ping_sent_us_, sizeof(uint32_t));
+  for (size_t i = 2 * sizeof(uint32_t); i < bench_frame_size_; i++) {
+    payload[i] = source_pattern_byte(i);
+  }
+  this->send_frame_(FRAME_TYPE_BENCH_PING, payload, bench_frame_size_);
+  bench_ping_outstanding_ = true;
+}
+
+void USBCommunicationComponent::send_benchmark_report_(bool completed) {
+  static const char *const MODE_NAMES[] = {"idle", "sink", "source", "rtt"};
+  std::string response;
+  response.reserve(320);
+  response += "{\"type\":\"benchmark_report\",\"mode\":\"";
+  response += MODE_NAMES[benchmark_.mode()];
+  response += "\",\"completed\":";
+  response += completed ? "true" : "false";
+  response += ",\"target\":";
+  response += std::to_string(benchmark_.target());
+  response += ",\"frames\":";
+  response += std::to_string(benchmark_.frames());
+  response += ",\"duration_us\":";
+  response += std::to_string(benchmark_.duration_us());
+  if (benchmark_.mode() == LinkBenchmark::MODE_RTT) {
+    response += ",\"lost\":";
+    response += std::to_string(benchmark_.lost());
+    response += ",\"min_us\":";
+    response += std::to_string(benchmark_.rtt_min_us());
+    response += ",\"mean_us\":";
+    response += std::to_string(benchmark_.rtt_mean_us());
+    response += ",\"max_us\":";
+    response += std::to_string(benchmark_.rtt_max_us());
+    response += ",\"bucket_us\":";
+    response += std::to_string(LinkBenchmark::RTT_FIRST_BUCKET_US);
+    response += ",\"histogram\":[";
+    for (size_t i = 0; i < LinkBenchmark::RTT_BUCKET_COUNT; i++) {
+      if (i > 0) response += ",";
+      response += std::to_string(benchmark_.rtt_histogram()[i]);
+    }
+    response += "]";
+  } else {
+    response += ",\"bytes\":";
+    response += std::to_string(benchmark_.progress());
+    response += ",\"bytes_per_second\":";
+    response += std::to_string(benchmark_.bytes_per_second());
+  }
+  response += ",\"rx_frames_lost\":";
+  response += std::to_string(rx_frames_lost_ - bench_start_frames_lost_);
+  response += ",\"rx_frame_errors\":";
+  response += std::to_string(rx_frame_errors_ - bench_start_frame_errors_);
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::process_benchmark_mic_convert_(const JsonMessage &message) {
+  // Times the unrolled conversion against the per-sample reference on synthetic frames; runs in loop(), keep it short
+  size_t frames = std::min<size_t>(message.get_int<size_t>("frames", MIC_CONVERT_BLOCK_SAMPLES),
+                                   MIC_CONVERT_BLOCK_SAMPLES);
+  uint32_t iterations = std::min<uint32_t>(message.get_int<uint32_t>("iterations", 100), 10000);
+  int32_t input[2 * MIC_CONVERT_BLOCK_SAMPLES];
+  int16_t reference_out[MIC_CONVERT_BLOCK_SAMPLES];
+  int16_t unrolled_out[MIC_CONVERT_BLOCK_SAMPLES];
+  uint32_t seed = 0x12345678;
+  for (size_t i = 0; i < 2 * frames; i++) {
+    seed = seed * 1664525 + 1013904223;
+    input[i] = static_cast<int32_t>(seed);
+  }
+
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < iterations; i++) {
+    convert_i2s_stereo_to_mono_reference(input, frames, mic_channel_, reference_out);
+  }
+  uint32_t reference_us = micros() - start;
+
+  start = micros();
+  for (uint32_t i = 0; i < iterations; i++) {
+    convert_i2s_stereo_to_mono(input, frames, mic_channel_, unrolled_out);
+  }
+  uint32_t unrolled_us = micros() - start;
+  bool match = memcmp(reference_out, unrolled_out, frames * sizeof(int16_t)) == 0;
+
+  std::string response;
+  response.reserve(160);
+  response += "{\"type\":\"benchmark_result\",\"name\":\"mic_convert\",\"frames\":";
+  response += std::to_string(frames);
+  response += ",\"iterations\":";
+  response += std::to_string(iterations);
+  response += ",\"reference_us\":";
+  response += std::to_string(reference_us);
+  response += ",\"unrolled_us\":";
+  response += std::to_string(unrolled_us);
+  response += ",\"match\":";
+  response += match ? "true" : "false";
+  response += "}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::process_finish_audio_stream_(const JsonMessage &message) {
+  this->finish_audio_stream();
+  this->send_response_("audio_stream_complete");
+}
+
+#ifdef USE_USB_COMMUNICATION_TRACE
+void USBCommunicationComponent::process_get_trace_(const JsonMessage &message) {
+  TraceEvent events[LatencyTrace::EVENT_COUNT];
+  size_t count = trace_.get_events(events, message.get_int<size_t>("count", LatencyTrace::EVENT_COUNT));
+
+  std::string response;
+  response.reserve(64 + count * 40);
+  response += "{\"type\":\"trace\",\"events\":[";
+  for (size_t i = 0; i < count; i++) {
+    if (i > 0) response += ",";
+    response += "[\"";
+    response += trace_stage_name(events[i].stage);
+    response += "\",";
+    response += std::to_string(events[i].timestamp_us);
+    response += ",";
+    response += std::to_string(events[i].latency_us);
+    response += "]";
+  }
+  response += "],\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::process_get_latency_stats_(const JsonMessage &message) {
+  std::string response;
+  response.reserve(96 + TRACE_STAGE_COUNT * 80);
+  response += "{\"type\":\"latency_stats\",\"stages\":{";
+  for (uint8_t stage = 0; stage < TRACE_STAGE_COUNT; stage++) {
+    TraceStats stats = trace_.get_stats(static_cast<TraceStage>(stage));
+    if (stage > 0) response += ",";
+    response += "\"";
+    response += trace_stage_name(static_cast<TraceStage>(stage));
+    response += "\":{\"count\":";
+    response += std::to_string(stats.count);
+    response += ",\"p50_us\":";
+    response += std::to_string(stats.p50_us);
+    response += ",\"p95_us\":";
+    response += std::to_string(stats.p95_us);
+    response += ",\"max_us\":";
+    response += std::to_string(stats.max_us);
+    response += "}";
+  }
+  response += "},\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+
+  if (message.get_bool("reset", false)) {
+    trace_.reset();
+  }
+}
+#endif
+
+void USBCommunicationComponent::request_unmute_() {
+  // Polled by is_unmute_requested() or delivered to on_unmute
+  unmute_requested_ = true;
+  this->unmute_callback_.call();
+}
+
+void USBCommunicationComponent::request_volume_(float volume) {
+  requested_volume_ = volume;
+  volume_change_requested_ = true;
+  this->volume_change_callback_.call(volume);
+}
+
+void USBCommunicationComponent::dispatch_events_() {
+  if (tone_event_pending_.exchange(false, std::memory_order_acquire)) {
+    this->tone_callback_.call(tone_event_frequency_, tone_event_duration_ms_);
+  }
+  if (playback_complete_event_pending_.exchange(false)) {
+    this->playback_complete_callback_.call();
+  }
+}
+
+void USBCommunicationComponent::process_config_(const JsonMessage &message) {
+  // Handle unmute request
+  if (message.get_bool("unmute", false)) {
+    ESP_LOGI(TAG, "Unmuting device via config");
+    this->request_unmute_();
+  }
+
+  // Handle volume setting
+  float volume = message.get_float("volume", -1.0f);
+  if (volume >= 0.0f) {
+    ESP_LOGI(TAG, "Setting volume to: %f", volume);
+    this->request_volume_(volume);
+  }
+
+  std::string_view wake_word = message.get_string("wake_word");
+  if (!wake_word.empty()) {
+    state_.set(STATE_WAKE_WORD, state_.wake_word, std::string(wake_word));
+    ESP_LOGD(TAG, "Setting wake word to: %s", state_.wake_word.c_str());
+  }
+
+  std::string_view sensitivity = message.get_string("sensitivity");
+  if (!sensitivity.empty()) {
+    state_.set(STATE_SENSITIVITY, state_.sensitivity, std::string(sensitivity));
+    ESP_LOGD(TAG, "Setting sensitivity to: %s", state_.sensitivity.c_str());
+  }
+  // Applying either to micro_wake_word is left to the YAML (on_config, or polling the getters)
+  if (!wake_word.empty() || !sensitivity.empty()) {
+    this->config_callback_.call(state_.wake_word, state_.sensitivity);
+  }
+
+  std::string_view phase_name = message.get_string("voice_phase");
+  if (!phase_name.empty()) {
+    // Map phase names to phase IDs (defined in YAML substitutions)
+    int phase_id = 1; // default to idle
+    if (phase_name == "waiting") phase_id = 2;
+    else if (phase_name == "listening") phase_id = 3;
+    else if (phase_name == "thinking") phase_id = 4;
+    else if (phase_name == "replying") phase_id = 5;
+    else if (phase_name == "idle") phase_id = 1;
+    else if (phase_name == "error") phase_id = 11;
+
+    ESP_LOGD(TAG, "Setting voice phase to: %d", phase_id);
+    this->update_voice_phase(phase_id);
+  }
+
+  this->send_response_("config_received");
+}
+
+size_t USBCommunicationComponent::write_decimal_samples_(std::string_view array) {
+  int16_t block[DECIMAL_SAMPLE_BLOCK];
+  size_t pending = 0;
+  size_t count = for_each_json_int(array, [&](long sample) {
+    block[pending++] = static_cast<int16_t>(std::max(-32768L, std::min(32767L, sample)));
+    if (pending == DECIMAL_SAMPLE_BLOCK) {
+      this->write_audio_chunk(reinterpret_cast<const uint8_t *>(block), sizeof(block));
+      pending = 0;
+    }
+  });
+  if (pending > 0) {
+    this->write_audio_chunk(reinterpret_cast<const uint8_t *>(block), pending * sizeof(int16_t));
+  }
+  return count;
+}
+
+void USBCommunicationComponent::process_play_audio_(const JsonMessage &message) {
+  // Check if this is part of a batch
+  bool is_batch = message.has("batch");
+  int batch_number = message.get_int<int>("batch", 1);
+  int total_batches = message.get_int<int>("total_batches", 1);
+
+  if (is_batch) {
+    ESP_LOGD(TAG, "Processing audio batch %d/%d", batch_number, total_batches);
+
+    // Initialize streaming on first batch
+    if (batch_number == 1) {
+      ESP_LOGD(TAG, "Starting batched audio stream for %d total batches", total_batches);
+      this->start_audio_stream();
+    }
+  }
+
+  std::string_view audio_data = message.get_raw("audio_data");
+  if (audio_data.empty()) {
+    ESP_LOGD(TAG, "No audio data found in play audio message");
+    return;
+  }
+
+  // For non-batch messages, start streaming
+  if (!is_batch) {
+    this->start_audio_stream();
+  }
+
+  this->begin_audio_segment_(message.get_int<uint32_t>("seq", batch_number));
+  size_t samples = this->write_decimal_samples_(audio_data);
+  ESP_LOGD(TAG, "Buffered audio batch %d data (%zu samples)", batch_number, samples);
+
+  // Only finish stream and play on last batch or non-batch messages
+  if (!is_batch || batch_number >= total_batches) {
+    ESP_LOGD(TAG, "Finishing audio stream and triggering playback");
+    this->finish_audio_stream();
+    this->send_response_("audio_played");
+  } else {
+    ESP_LOGD(TAG, "Waiting for more batches before playback");
+    // Acknowledge the batch with the current credit; hosts that follow credits need not wait for it
+    this->send_credit_response_("batch_received");
+  }
+}
+
+void USBCommunicationComponent::process_play_audio_compressed_(const JsonMessage &message) {
+  if (!message.has("audio_base64")) {
+    ESP_LOGD(TAG, "No compressed audio data found in message");
+    return;
+  }
+  std::string_view base64_audio = message.get_string("audio_base64");
+
+  // The first message of a clip opens the stream; later parts continue decoding where the previous one stopped
+  if (!compressed_stream_active_) {
+    this->start_audio_stream();
+    base64_decoder_.reset();
+    compressed_stream_active_ = true;
+    compressed_bytes_decoded_ = 0;
+    compressed_expected_samples_ = 0;
+  }
+  compressed_expected_samples_ = message.get_int<long>("sample_count", compressed_expected_samples_);
+
+  this->begin_audio_segment_(message.get_int<uint32_t>("seq", audio_sequence_ + 1));
+
+  // Decode straight from the message into the playback buffer in small blocks
+  uint8_t block[BASE64_DECODE_BLOCK_SIZE];
+  const char *input = base64_audio.data();
+  size_t remaining = base64_audio.size();
+  while (remaining > 0 && !base64_decoder_.has_error()) {
+    size_t consumed = 0;
+    size_t decoded = base64_decoder_.decode(input, remaining, block, sizeof(block), &consumed);
+    this->write_audio_chunk(block, decoded);
+    compressed_bytes_decoded_ += decoded;
+    input += consumed;
+    remaining -= consumed;
+  }
+
+  if (base64_decoder_.has_error()) {
+    ESP_LOGW(TAG, "Invalid base64 audio data, aborting stream");
+    compressed_stream_active_ = false;
+    this->clear_audio_buffer();
+    this->finish_audio_stream();
+    this->send_response_("audio_decode_error");
+    return;
+  }
+
+  if (!message.get_bool("final", true)) {
+    this->send_credit_response_("batch_received");
+    return;
+  }
+
+  size_t samples_decoded = compressed_bytes_decoded_ / sizeof(int16_t);
+  if (compressed_expected_samples_ > 0 && samples_decoded != static_cast<size_t>(compressed_expected_samples_)) {
+    ESP_LOGW(TAG, "Compressed audio decoded to %zu samples, expected %ld", samples_decoded,
+             compressed_expected_samples_);
+  }
+  ESP_LOGD(TAG, "Finishing compressed audio stream, %zu samples", samples_decoded);
+  compressed_stream_active_ = false;
+  this->finish_audio_stream();
+  this->send_response_("audio_played");
+}
+
+void USBCommunicationComponent::process_play_tone_(const JsonMessage &message) {
+  // Either a single tone (frequency, duration_ms) or a sequence: "notes":[[frequency, duration_ms, gap_ms], ...]
+  if (target_speaker_ == nullptr) {
+    ESP_LOGI(TAG, "No speaker set; triggering the YAML sound instead of a tone");
+    tone_playback_requested_ = true;
+    // May be on the pipeline task; loop() hands it to on_tone
+    tone_event_frequency_ = message.get_int<uint16_t>("frequency", 440);
+    tone_event_duration_ms_ = message.get_int<uint16_t>("duration_ms", 500);
+    tone_event_pending_.store(true, std::memory_order_release);
+    this->send_response_("audio_played");
+    return;
+  }
+
+  tone_.clear();
+  tone_.set_sample_rate(this->speaker_sample_rate_());
+  ToneSynth::Envelope envelope;
+  envelope.attack_ms = message.get_int<uint16_t>("attack_ms", envelope.attack_ms);
+  envelope.decay_ms = message.get_int<uint16_t>("decay_ms", envelope.decay_ms);
+  envelope.release_ms = message.get_int<uint16_t>("release_ms", envelope.release_ms);
+  float sustain = std::max(0.0f, std::min(1.0f, message.get_float("sustain", envelope.sustain / 32768.0f)));
+  envelope.sustain = static_cast<uint16_t>(sustain * 32767.0f);
+  tone_.set_envelope(envelope);
+  float volume = std::max(0.0f, std::min(1.0f, message.get_float("volume", 0.5f)));
+  tone_.set_amplitude(static_cast<uint16_t>(volume * 32767.0f));
+
+  size_t notes = 0;
+  std::string_view sequence = message.get_raw("notes");
+  if (!sequence.empty()) {
+    long fields[3];
+    size_t field = 0;
+    for_each_json_int(sequence, [&](long value) {
+      fields[field++] = std::max(0L, std::min(65535L, value));
+      if (field == 3) {
+        notes += tone_.add_note(fields[0], fields[1], fields[2]) ? 1 : 0;
+        field = 0;
+      }
+    });
+  } else if (tone_.add_note(message.get_int<uint16_t>("frequency", 440),
+                            message.get_int<uint16_t>("duration_ms", 500), 0)) {
+    notes = 1;
+  }
+  if (notes == 0) {
+    ESP_LOGW(TAG, "play_tone without any notes");
+    this->send_response_("tone_complete");
+    return;
+  }
+
+  ESP_LOGD(TAG, "Playing %zu note tone", notes);
+  if (!tone_playing_ && playback_state_ == PLAYBACK_IDLE) {
+    this->run_on_main_loop_(COMMAND_SPEAKER_START);
+  }
+  tone_playing_ = true;
+  this->send_response_("tone_started");
+  this->feed_speaker_();
+}
+
+void USBCommunicationComponent::process_play_audio_chunk_(const JsonMessage &message) {
+  if (message.get_bool("is_start", false)) {
+    // Initialize new audio reception
+    ESP_LOGD(TAG, "Starting new chunked audio reception");
+    chunk_bitmap_ = 0;
+    chunk_next_ = 0;
+    chunk_total_ = std::max(0, message.get_int<int>("total_chunks", 0));
+    chunk_stride_bytes_ = message.get_int<size_t>("chunk_samples", 0) * sizeof(int16_t);
+    chunk_last_bytes_ = 0;
+    this->start_audio_stream();
+    ESP_LOGD(TAG, "Expecting %u audio chunks", (unsigned) chunk_total_);
+    return;
+  }
+
+  int chunk_number = message.get_int<int>("chunk_index", -1);
+  std::string_view audio_data = message.get_raw("audio_data");
+  if (audio_data.empty() || chunk_number <= 0 || static_cast<uint32_t>(chunk_number) > chunk_total_) {
+    return;
+  }
+  uint32_t chunk = chunk_number - 1;
+  bool last_chunk = chunk + 1 == chunk_total_;
+
+  if (chunk < chunk_next_ || (chunk - chunk_next_ < CHUNK_WINDOW && (chunk_bitmap_ >> (chunk - chunk_next_)) & 1)) {
+    ESP_LOGV(TAG, "Ignoring duplicate audio chunk %d", chunk_number);
+    return;
+  }
+
+  // Sample count from the separators, so the chunk's slot can be checked before anything is written
+  size_t samples = std::count(audio_data.begin(), audio_data.end(), ',') + 1;
+  size_t length = samples * sizeof(int16_t);
+  if (chunk_stride_bytes_ == 0 && !last_chunk) {
+    chunk_stride_bytes_ = length;
+  }
+  if (chunk_stride_bytes_ == 0 && chunk > 0) {
+    // Only the last chunk has arrived so far; its offset is unknown until another chunk sets the stride
+    this->send_chunk_dropped_(chunk_number, "stride_unknown");
+    return;
+  }
+  if (last_chunk ? (length > chunk_stride_bytes_ && chunk > 0) : (length != chunk_stride_bytes_)) {
+    ESP_LOGW(TAG, "Audio chunk %d has %zu samples, expected %zu", chunk_number, samples,
+             chunk_stride_bytes_ / sizeof(int16_t));
+    this->send_chunk_dropped_(chunk_number, "bad_length");
+    return;
+  }
+
+  uint32_t slot = chunk - chunk_next_;
+  size_t offset = slot * chunk_stride_bytes_;
+  if (slot < CHUNK_WINDOW && offset + length > playback_buffer_size_ - usb_audio_buffer_size_ &&
+      playback_state_ == PLAYBACK_PLAYING) {
+    this->feed_speaker_();
+  }
+  if (slot >= CHUNK_WINDOW || offset + length > playback_buffer_size_ - usb_audio_buffer_size_) {
+    this->send_chunk_dropped_(chunk_number, "no_space");
+    return;
+  }
+
+  // Parse straight into the chunk's slot in the ring. Slots are sample aligned and the ring size is even, so a
+  // sample never straddles the wrap.
+  size_t position = (usb_audio_buffer_index_ + offset) % playback_buffer_size_;
+  size_t parsed = 0;
+  for_each_json_int(audio_data, [this, &position, &parsed, samples](long value) {
+    if (parsed == samples) {
+      return;
+    }
+    int16_t sample = static_cast<int16_t>(std::max(-32768L, std::min(32767L, value)));
+    memcpy(usb_audio_buffer_ + position, &sample, sizeof(sample));
+    position = (position + sizeof(sample)) % playback_buffer_size_;
+    parsed++;
+  });
+  for (; parsed < samples; parsed++) {
+    memset(usb_audio_buffer_ + position, 0, sizeof(int16_t));
+    position = (position + sizeof(int16_t)) % playback_buffer_size_;
+  }
+  chunk_bitmap_ |= uint64_t(1) << slot;
+  if (last_chunk) {
+    chunk_last_bytes_ = length;
+  }
+
+  // Commit whatever prefix is now contiguous so playback can start without waiting for the rest
+  while (chunk_bitmap_ & 1) {
+    this->commit_audio_(chunk_next_ + 1 == chunk_total_ ? chunk_last_bytes_ : chunk_stride_bytes_);
+    chunk_bitmap_ >>= 1;
+    chunk_next_++;
+  }
+
+  ESP_LOGD(TAG, "Audio chunk %d received with %zu samples (%u/%u contiguous)", chunk_number, samples,
+           (unsigned) chunk_next_, (unsigned) chunk_total_);
+
+  if (chunk_next_ == chunk_total_) {
+    ESP_LOGD(TAG, "All chunks received");
+
+    // Finish the stream and trigger playback
+    this->finish_audio_stream();
+    this->send_response_("audio_played");
+
+    // Reset for next audio
+    chunk_bitmap_ = 0;
+    chunk_next_ = 0;
+    chunk_total_ = 0;
+  }
+}
+
+void USBCommunicationComponent::send_chunk_dropped_(uint32_t chunk_index, const char *reason) {
+  // The host resends the chunk later; nothing was written for it
+  chunks_dropped_++;
+  ESP_LOGW(TAG, "Dropping audio chunk %u: %s", (unsigned) chunk_index, reason);
+  std::string response = "{\"type\":\"chunk_dropped\",\"chunk_index\":";
+  response += std::to_string(chunk_index);
+  response += ",\"reason\":\"";
+  response += reason;
+  response += "\"}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::send_status_update_() {
+  // Full snapshot: every state field plus link diagnostics
+  std::string status;
+  status.reserve(768);
+
+  status += "{";
+  status += "\"type\":\"status\",";
+  status += "\"version\":";
+  status += std::to_string(state_.version);
+  status += ",";
+  status += "\"timestamp\":";
+  status += std::to_string(millis());
+  state_.append_json(status, STATE_ALL);
+  status += ",";
+  status += "\"binary_frames\":true,";
+  status += "\"rx_bytes\":";
+  status += std::to_string(rx_bytes_total_);
+  status += ",";
+  status += "\"rx_bytes_per_second\":";
+  status += std::to_string(rx_bytes_per_second_);
+  status += ",";
+  status += "\"rx_frames\":";
+  status += std::to_string(rx_frame_count_);
+  status += ",";
+  status += "\"rx_frames_lost\":";
+  status += std::to_string(rx_frames_lost_);
+  status += ",";
+  status += "\"rx_frame_errors\":";
+  status += std::to_string(rx_frame_errors_);
+  status += ",";
+  status += "\"rx_line_overflows\":";
+  status += std::to_string(rx_line_overflows_);
+  status += ",";
+  status += "\"mic_uplink_active\":";
+  status += mic_uplink_active_ ? "true" : "false";
+  status += ",";
+  status += "\"mic_frames_sent\":";
+  status += std::to_string(mic_frames_sent_);
+  if (capture_mode_ == UPLINK_AUTO) {
+    status += ",\"uplink_channel\":";
+    status += std::to_string(channel_selector_.channel());
+    status += ",\"uplink_channel_switches\":";
+    status += std::to_string(channel_selector_.switches());
+  }
+  status += ",";
+  status += "\"mic_peak\":";
+  status += std::to_string(mic_peak_level_.load(std::memory_order_relaxed));
+  status += ",";
+  status += "\"injected_audio_dropped\":";
+  status += std::to_string(injected_audio_buffer_.dropped());
+  status += ",";
+  status += "\"audio_chunks_dropped\":";
+  status += std::to_string(chunks_dropped_);
+  status += ",";
+  status += "\"audio_bytes_dropped\":";
+  status += std::to_string(audio_bytes_dropped_);
+  status += ",";
+  status += "\"tx_control_dropped\":";
+  status += std::to_string(tx_queue_.dropped(TxQueue::PRIORITY_CONTROL));
+  status += ",";
+  status += "\"tx_bulk_dropped\":";
+  status += std::to_string(tx_queue_.dropped(TxQueue::PRIORITY_BULK));
+  if (clip_cache_.capacity() > 0) {
+    status += ",\"clip_cache_clips\":";
+    status += std::to_string(clip_cache_.count());
+    status += ",\"clip_cache_free\":";
+    status += std::to_string(clip_cache_.capacity() - clip_cache_.used());
+    status += ",\"clip_cache_evictions\":";
+    status += std::to_string(clip_cache_.evictions());
+  }
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  if (voice_kit_ != nullptr) {
+    status += ",\"xmos_ready\":";
+    status += voice_kit_->is_xmos_ready() ? "true" : "false";
+  }
+  if (voice_kit_ != nullptr && voice_kit_->has_vnr()) {
+    status += ",\"vnr\":";
+    status += std::to_string(voice_kit_->get_cached_vnr());
+  }
+  if (vnr_gate_enabled_) {
+    status += ",\"mic_frames_suppressed\":";
+    status += std::to_string(mic_frames_suppressed_);
+  }
+#endif
+  status += "}";
+
+  this->send_json_(status);
+}
+
+void USBCommunicationComponent::send_status_delta_() {
+  std::string delta;
+  delta.reserve(192);
+
+  // One version per delta, however many fields changed since the last one
+  uint16_t fields = state_.commit();
+  delta += "{\"type\":\"status_delta\",\"version\":";
+  delta += std::to_string(state_.version);
+  delta += ",\"timestamp\":";
+  delta += std::to_string(millis());
+  state_.append_json(delta, fields);
+  delta += "}";
+
+  this->send_json_(delta);
+}
+
+void USBCommunicationComponent::send_wake_word_options_() {
+  // Wake word options based on the ESPHome configuration
+  // These match the wake words loaded in the micro_wake_word component
+  std::string options;
+  options.reserve(256);
+
+  options += "{";
+  options += "\"type\":\"wake_word_options\",";
+  options += "\"options\":[\"Okay Nabu\",\"Hey Jarvis\",\"Hey Mycroft\",\"Stop\"],";
+  options += "\"timestamp\":";
+  options += std::to_string(millis());
+  options += "}";
+
+  this->send_json_(options);
+}
+
+void USBCommunicationComponent::send_response_(const char* response_type) {
+  std::string response;
+  response.reserve(128);
+
+  response += "{\"type\":\"";
+  response += response_type;
+  response += "\",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::send_json_(const std::string &json) {
+  static const uint8_t NEWLINE = '\n';
+  if (pipeline_task_handle_ != nullptr && !this->on_pipeline_task_()) {
+    // Only the pipeline task touches the TX queue
+    if (json.size() + 1 > from_main_loop_.max_message()) {
+      ESP_LOGW(TAG, "%zu byte message is too long for the pipeline task, dropping", json.size());
+    } else if (!from_main_loop_.push(reinterpret_cast<const uint8_t *>(json.data()), json.size(), &NEWLINE, 1)) {
+      ESP_LOGW(TAG, "Main loop channel full, dropping %zu byte message", json.size());
+    }
+    return;
+  }
+  if (!tx_queue_.push(TxQueue::PRIORITY_CONTROL, reinterpret_cast<const uint8_t *>(json.data()), json.size(),
+                      &NEWLINE, 1)) {
+    ESP_LOGW(TAG, "TX queue full, dropping %zu byte message", json.size());
+  }
+}
+
+void USBCommunicationComponent::send_frame_(uint8_t type, const uint8_t *payload, uint16_t length, uint8_t flags) {
+  // Frames bypass stdout, which would translate '\n' bytes in the payload into CRLF
+  uint8_t header[FRAME_HEADER_SIZE];
+  encode_frame_header(header, type, flags, tx_frame_sequence_++, payload, length);
+  bool bulk = type == FRAME_TYPE_MIC_AUDIO || type == FRAME_TYPE_MIC_AUDIO_STEREO || type == FRAME_TYPE_MIC_SILENCE ||
+              type == FRAME_TYPE_BENCH_SOURCE;
+  TxQueue::Priority priority = bulk ? TxQueue::PRIORITY_BULK : TxQueue::PRIORITY_CONTROL;
+  tx_queue_.push(priority, header, sizeof(header), payload, length);
+}
+
+void USBCommunicationComponent::send_line_overflow_() {
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"line_overflow\",\"limit\":";
+  response += std::to_string(max_line_length_);
+  response += ",\"count\":";
+  response += std::to_string(rx_line_overflows_);
+  response += "}";
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::send_frame_error_(const char *reason, uint16_t sequence) {
+  std::string response;
+  response.reserve(96);
+
+  response += "{\"type\":\"frame_error\",\"reason\":\"";
+  response += reason;
+  response += "\",\"sequence\":";
+  response += std::to_string(sequence);
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+
+  this->send_json_(response);
+}
+
+void USBCommunicationComponent::process_audio_data_chunk_(const JsonMessage &message) {
+  // Extract binary audio data from JSON array and write to stream buffer
+  std::string_view data = message.get_raw("data");
+  if (data.empty()) {
+    return;
+  }
+
+  // The chunk is collected whole because an ADPCM block has to be decoded from its header
+  size_t length = 0;
+  size_t count = for_each_json_int(data, [this, &length](long byte_val) {
+    if (length < FRAME_MAX_PAYLOAD) {
+      chunk_bytes_[length++] = static_cast<uint8_t>(byte_val & 0xFF);
+    }
+  });
+  if (count > length) {
+    ESP_LOGW(TAG, "Audio data chunk of %zu bytes truncated to %zu", count, length);
+  }
+
+  ESP_LOGD(TAG, "Received audio data chunk with %zu bytes", length);
+
+  // Write chunk to streaming buffer
+  if (length > 0) {
+    this->begin_audio_segment_(message.get_int<uint32_t>("seq", audio_sequence_ + 1));
+    this->write_encoded_audio_(chunk_bytes_, length);
+  }
+}
+
+void USBCommunicationComponent::process_start_audio_stream_(const JsonMessage &message) {
+  AudioCodec codec = AUDIO_CODEC_PCM_S16LE;
+  std::string_view codec_name = message.get_string("codec", "pcm");
+  if (codec_name == "ima_adpcm") {
+    codec = AUDIO_CODEC_IMA_ADPCM;
+  } else if (codec_name != "pcm") {
+    ESP_LOGW(TAG, "Unsupported audio codec '%.*s'", static_cast<int>(codec_name.size()), codec_name.data());
+    this->send_json_("{\"type\":\"audio_stream_error\",\"reason\":\"unsupported_codec\",\"timestamp\":" +
+                     std::to_string(millis()) + "}");
+    return;
+  }
+
+  uint32_t output_rate = this->speaker_sample_rate_();
+  uint32_t sample_rate = message.get_int<uint32_t>("sample_rate", output_rate);
+  if (sample_rate != output_rate && !resampler_.configure(sample_rate, output_rate)) {
+    ESP_LOGW(TAG, "Cannot resample %u Hz to %u Hz", (unsigned) sample_rate, (unsigned) output_rate);
+    this->send_json_("{\"type\":\"audio_stream_error\",\"reason\":\"unsupported_sample_rate\",\"timestamp\":" +
+                     std::to_string(millis()) + "}");
+    return;
+  }
+
+  this->start_audio_stream();
+  stream_codec_ = codec;
+  stream_sample_rate_ = sample_rate;
+  resampling_ = sample_rate != output_sample_rate_;
+
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"audio_stream_started\",\"codec\":\"";
+  response.append(codec_name.data(), codec_name.size());
+  response += "\",\"sample_rate\":";
+  response += std::to_string(sample_rate);
+  response += ",\"output_sample_rate\":";
+  response += std::to_string(output_sample_rate_);
+  response += ",\"credit\":";
+  response += std::to_string(this->credit_limit_());
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+  credit_sent_limit_ = this->credit_limit_();
+  last_credit_time_ = millis();
+}
+
+void USBCommunicationComponent::write_encoded_audio_(const uint8_t *data, size_t length) {
+  if (stream_codec_ == AUDIO_CODEC_PCM_S16LE) {
+    // Already little-endian int16 PCM, matching the playback buffer layout
+    this->write_audio_chunk(data, length);
+    return;
+  }
+
+  // IMA-ADPCM: each frame/chunk is one self-contained block
+  if (length < IMA_ADPCM_BLOCK_HEADER_SIZE) {
+    ESP_LOGW(TAG, "ADPCM block too short (%zu bytes)", length);
+    return;
+  }
+  int16_t samples[2 * ADPCM_DECODE_BLOCK_BYTES];
+  if (!adpcm_decoder_.begin_block(data, &samples[0])) {
+    ESP_LOGW(TAG, "Invalid ADPCM block header");
+    return;
+  }
+  this->write_audio_chunk(reinterpret_cast<const uint8_t *>(samples), sizeof(int16_t));
+
+  data += IMA_ADPCM_BLOCK_HEADER_SIZE;
+  length -= IMA_ADPCM_BLOCK_HEADER_SIZE;
+  while (length > 0) {
+    size_t block = std::min(length, ADPCM_DECODE_BLOCK_BYTES);
+    adpcm_decoder_.decode(data, block, samples);
+    this->write_audio_chunk(reinterpret_cast<const uint8_t *>(samples), 2 * block * sizeof(int16_t));
+    data += block;
+    length -= block;
+  }
+}
+
+// USB Audio streaming methods (replicating voice assistant architecture)
+void USBCommunicationComponent::start_audio_stream() {
+  ESP_LOGD(TAG, "Starting USB audio stream");
+  // Any new stream, a clip included, replaces a clip that is still playing
+  clip_play_slot_ = ClipCache::NO_CLIP;
+  usb_audio_buffer_index_ = 0;
+  usb_audio_buffer_read_index_ = 0;
+  usb_audio_buffer_size_ = 0;
+  stream_bytes_accepted_ = 0;
+  credit_sent_limit_ = 0;
+  audio_sequence_ = 0;
+  audio_sequence_dropped_ = false;
+  audio_carry_pending_ = false;
+  is_streaming_audio_ = true;
+#ifdef USE_USB_COMMUNICATION_TRACE
+  trace_stream_start_us_ = micros();
+  trace_first_play_pending_ = true;
+#endif
+  stream_codec_ = AUDIO_CODEC_PCM_S16LE;
+  compressed_stream_active_ = false;
+  // Streams play at the speaker's native rate unless start_audio_stream declares another
+  output_sample_rate_ = this->speaker_sample_rate_();
+  stream_sample_rate_ = output_sample_rate_;
+  resampling_ = false;
+  resampler_.reset();
+  playback_state_ = PLAYBACK_BUFFERING;
+}
+
+uint32_t USBCommunicationComponent::speaker_sample_rate_() const {
+  return target_speaker_ != nullptr ? target_speaker_->get_audio_stream_info().get_sample_rate() : 16000;
+}
+
+void USBCommunicationComponent::write_audio_chunk(const uint8_t *data, size_t length) {
+  if (!is_streaming_audio_) {
+    ESP_LOGW(TAG, "Attempted to write audio chunk without starting stream");
+    return;
+  }
+  if (length == 0) {
+    return;
+  }
+  // Chunks may split a sample: the odd byte is held and completed by the first byte of the next chunk
+  if (audio_carry_pending_) {
+    const uint8_t sample[sizeof(int16_t)] = {audio_carry_byte_, data[0]};
+    audio_carry_pending_ = false;
+    this->write_audio_samples_(sample, sizeof(sample));
+    data++;
+    length--;
+  }
+  if (length % sizeof(int16_t) != 0) {
+    length--;
+    audio_carry_byte_ = data[length];
+    audio_carry_pending_ = true;
+  }
+  this->write_audio_samples_(data, length);
+}
+
+void USBCommunicationComponent::write_audio_samples_(const uint8_t *data, size_t length) {
+  if (!resampling_) {
+    this->write_playback_buffer_(data, length);
+    return;
+  }
+
+  // Convert from the stream's sample rate to the speaker's in small blocks; data may not be int16 aligned in memory
+  int16_t input[RESAMPLE_BLOCK_SAMPLES];
+  int16_t output[RESAMPLE_OUTPUT_SAMPLES];
+  size_t samples = length / sizeof(int16_t);
+  while (samples > 0) {
+    size_t block = std::min(samples, RESAMPLE_BLOCK_SAMPLES);
+    memcpy(input, data, block * sizeof(int16_t));
+    size_t offset = 0;
+    while (offset < block) {
+      size_t used = 0;
+      size_t produced = resampler_.process(input + offset, block - offset, output, RESAMPLE_OUTPUT_SAMPLES, &used);
+      if (used == 0 && produced == 0) {
+        // configure() keeps the ratio within the output block, so this only guards against a spin
+        ESP_LOGE(TAG, "Resampler made no progress, dropping %zu samples", samples);
+        return;
+      }
+      this->write_playback_buffer_(reinterpret_cast<const uint8_t *>(output), produced * sizeof(int16_t));
+      offset += used;
+    }
+    data += block * sizeof(int16_t);
+    samples -= block;
+  }
+}
+
+void USBCommunicationComponent::write_playback_buffer_(const uint8_t *data, size_t length) {
+  if (length == 0) {
+    return;
+  }
+  USB_TRACE_MARK(write_start);
+
+  // Make room by handing buffered audio to the speaker before giving up on the chunk
+  if (usb_audio_buffer_size_ + length > playback_buffer_size_ && playback_state_ == PLAYBACK_PLAYING) {
+    this->feed_speaker_();
+  }
+
+  // Check buffer space (same as voice assistant)
+  if (usb_audio_buffer_size_ + length > playback_buffer_size_) {
+    this->report_audio_drop_(length);
+    return;
+  }
+
+  // Copy audio data to the ring, wrapping at the end of the buffer
+  size_t first = std::min(length, playback_buffer_size_ - usb_audio_buffer_index_);
+  memcpy(usb_audio_buffer_ + usb_audio_buffer_index_, data, first);
+  memcpy(usb_audio_buffer_, data + first, length - first);
+  this->commit_audio_(length);
+  USB_TRACE_RECORD(trace_, TRACE_BUFFER_WRITE, write_start);
+
+  ESP_LOGV(TAG, "Wrote %zu bytes to USB audio buffer (total: %zu/%zu)",
+           length, usb_audio_buffer_size_, playback_buffer_size_);
+}
+
+void USBCommunicationComponent::commit_audio_(size_t length) {
+  // Makes length bytes already written at usb_audio_buffer_index_ playable
+  usb_audio_buffer_index_ = (usb_audio_buffer_index_ + length) % playback_buffer_size_;
+  usb_audio_buffer_size_ += length;
+  stream_bytes_accepted_ += length;
+
+  // 16-bit mono at the speaker's rate
+  if (playback_state_ == PLAYBACK_BUFFERING &&
+      usb_audio_buffer_size_ >= prebuffer_ms_ * output_sample_rate_ / 1000 * sizeof(int16_t)) {
+    this->begin_playback_();
+  }
+}
+
+void USBCommunicationComponent::begin_audio_segment_(uint32_t sequence) {
+  audio_sequence_ = sequence;
+  audio_sequence_dropped_ = false;
+}
+
+void USBCommunicationComponent::report_audio_drop_(size_t length) {
+  audio_bytes_dropped_ += length;
+  if (audio_sequence_dropped_) {
+    return;
+  }
+
+  // One report per frame or message; the host resends it or conceals the gap
+  audio_sequence_dropped_ = true;
+  ESP_LOGW(TAG, "USB audio buffer overflow, dropping audio from sequence %u", (unsigned) audio_sequence_);
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"audio_dropped\",\"seq\":";
+  response += std::to_string(audio_sequence_);
+  response += ",\"bytes\":";
+  response += std::to_string(length);
+  response += ",\"credit\":";
+  response += std::to_string(this->credit_limit_());
+  response += "}";
+  this->send_json_(response);
+}
+
+uint32_t USBCommunicationComponent::credit_limit_() const {
+  // Accounted at the playback rate, granted in the host's bytes at the stream's rate
+  uint64_t limit = stream_bytes_accepted_ + (playback_buffer_size_ - usb_audio_buffer_size_);
+  return resampling_ ? limit * stream_sample_rate_ / output_sample_rate_ : limit;
 }
 
-void USBCommunicationComponent::dump_config() {
-  ESP_LOGCONFIG(TAG, "USB Communication:");
+void USBCommunicationComponent::send_credit_() {
+  // limit counts decoded PCM bytes since start_audio_stream, so ADPCM hosts account for decoded size
+  uint32_t limit = this->credit_limit_();
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"credit\",\"limit\":";
+  response += std::to_string(limit);
+  response += ",\"free\":";
+  response += std::to_string(playback_buffer_size_ - usb_audio_buffer_size_);
+  response += ",\"buffered\":";
+  response += std::to_string(usb_audio_buffer_size_);
+  response += "}";
+  this->send_json_(response);
+  credit_sent_limit_ = limit;
+  last_credit_time_ = millis();
 }
 
-void USBCommunicationComponent::loop() {
-  // Read incoming data with timeout protection
-  static std::string line_buffer;
-  static unsigned long last_read_time = 0;
-  static bool boot_message_sent = false;
-  unsigned long now = millis();
-  
-  // Send a boot message after 3 seconds to verify UART communication
-  if (!boot_message_sent && now > 3000) {
-    this->send_response_("boot_complete");
-    boot_message_sent = true;
+void USBCommunicationComponent::send_credit_response_(const char *response_type) {
+  std::string response;
+  response.reserve(128);
+
+  response += "{\"type\":\"";
+  response += response_type;
+  response += "\",\"credit\":";
+  response += std::to_string(this->credit_limit_());
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+
+  this->send_json_(response);
+  credit_sent_limit_ = this->credit_limit_();
+  last_credit_time_ = millis();
+}
+
+void USBCommunicationComponent::finish_audio_stream() {
+  ESP_LOGD(TAG, "Finishing USB audio stream - %zu bytes buffered", usb_audio_buffer_size_);
+  is_streaming_audio_ = false;
+  // Half a sample left at the end of the stream cannot be played
+  audio_carry_pending_ = false;
+#ifdef USE_USB_COMMUNICATION_TRACE
+  trace_stream_finish_us_ = micros();
+#endif
+
+  if (target_speaker_ == nullptr) {
+    ESP_LOGE(TAG, "No speaker configured! Cannot play audio.");
+    playback_state_ = PLAYBACK_IDLE;
+    return;
   }
-  
-  // Clear buffer if it gets too old (prevent memory buildup)
-  if (now - last_read_time > 5000 && !line_buffer.empty()) {
-    line_buffer.clear();
-    last_read_time = now;
-  }
-  
-  if (this->read_line_(&line_buffer)) {
-    this->process_message_(line_buffer);
-    line_buffer.clear();  // Clear buffer after processing
-    last_read_time = now;
-  }
-  
-  // Send periodic status updates less frequently to avoid overwhelming
-  static unsigned long last_status_update = 0;
-  if (now - last_status_update > 10000) {  // Every 10 seconds
-    this->send_status_update_();
-    last_status_update = now;
-  }
-}
-
-bool USBCommunicationComponent::read_line_(std::string *line) {
-  // Read from stdin (USB Serial/JTAG) character by character
-  int c = getchar();
-  
-  if (c == EOF) {
-    return false;  // No data available
-  }
-  
-  if (c == '\n') {
-    if (!input_buffer_.empty()) {
-      *line = input_buffer_;
-      ESP_LOGD(TAG, "Complete line received: %s", line->c_str());
-      input_buffer_.clear();
-      return true;
-    }
-  } else if (c != '\r') {
-    // Prevent buffer overflow
-    if (input_buffer_.length() < 512) {
-      input_buffer_.push_back(static_cast<char>(c));
-    } else {
-      // Buffer too large, clear it
-      ESP_LOGW(TAG, "Input buffer overflow, clearing");
-      input_buffer_.clear();
+
+  if (playback_state_ == PLAYBACK_BUFFERING) {
+    if (usb_audio_buffer_size_ == 0) {
+      ESP_LOGW(TAG, "No audio data to play");
+      playback_state_ = PLAYBACK_IDLE;
+      return;
     }
+    // Short clip that never reached the prebuffer threshold
+    this->begin_playback_();
   }
-  
-  return false;
-}
 
-void USBCommunicationComponent::mark_usb_activity() {
-  // Function to be called from YAML to mark USB activity
-  // This will be implemented in the YAML lambda
+  if (playback_state_ == PLAYBACK_PLAYING) {
+    playback_state_ = PLAYBACK_DRAINING;
+    this->feed_speaker_();
+  }
 }
 
-void USBCommunicationComponent::process_message_(const std::string &message) {
-  // Update heartbeat timestamp - this will be accessed by YAML interval
-  static unsigned long last_message_time = 0;
-  last_message_time = millis();
-  
-  // Debug: Log received message (temporarily)
-  ESP_LOGI(TAG, "Received message: %s", message.c_str());
-  ESP_LOGI(TAG, "Message length: %d", message.length());
-  
-  // Simple JSON parsing for basic commands
-  if (message.find("\"type\":\"heartbeat\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing heartbeat, sending ack");
-    this->send_response_("heartbeat_ack");
-  }
-  else if (message.find("\"type\":\"get_status\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing get_status request");
-    this->send_status_update_();
-  }
-  else if (message.find("\"type\":\"get_wake_word_options\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing get_wake_word_options request");
-    this->send_wake_word_options_();
-  }
-  else if (message.find("\"type\":\"config\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing config message");
-    this->process_config_(message);
-  }
-  else if (message.find("\"type\":\"disconnect\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing disconnect message");
-    // Handle explicit disconnection
-    last_message_time = 0;  // Force timeout
-  }
-  else if (message.find("\"type\":\"play_tone\"") != std::string::npos) {
-    ESP_LOGI(TAG, "Processing play tone message");
-    this->process_play_tone_(message);
-  }
-  else if (message.find("\"type\":\"play_audio_compressed\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing compressed play audio message");
-    this->process_play_audio_compressed_(message);
-  }
-  else if (message.find("\"type\":\"play_audio\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing play audio message");
-    this->process_play_audio_(message);
-  }
-  else if (message.find("\"type\":\"play_audio_chunk\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing play audio chunk message");
-    this->process_play_audio_chunk_(message);
-  }
-  else if (message.find("\"type\":\"start_audio_stream\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing start audio stream");
-    this->start_audio_stream();
-  }
-  else if (message.find("\"type\":\"audio_data_chunk\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing audio data chunk");
-    this->process_audio_data_chunk_(message);
+void USBCommunicationComponent::stage_speaker_block_() {
+  // Next stream block, if the stream is past its prebuffer, with the next block of the tone added on top
+  size_t stream_samples = 0;
+  if (playback_state_ == PLAYBACK_PLAYING || playback_state_ == PLAYBACK_DRAINING) {
+    size_t bytes = std::min(usb_audio_buffer_size_, sizeof(tone_block_)) & ~size_t(1);
+    size_t first = std::min(bytes, playback_buffer_size_ - usb_audio_buffer_read_index_);
+    auto *block = reinterpret_cast<uint8_t *>(tone_block_);
+    memcpy(block, usb_audio_buffer_ + usb_audio_buffer_read_index_, first);
+    memcpy(block + first, usb_audio_buffer_, bytes - first);
+    usb_audio_buffer_read_index_ = (usb_audio_buffer_read_index_ + bytes) % playback_buffer_size_;
+    usb_audio_buffer_size_ -= bytes;
+    stream_samples = bytes / sizeof(int16_t);
   }
-  else if (message.find("\"type\":\"finish_audio_stream\"") != std::string::npos) {
-    ESP_LOGD(TAG, "Processing finish audio stream");
-    this->finish_audio_stream();
-    this->send_response_("audio_stream_complete");
-  }
-  else {
-    ESP_LOGI(TAG, "Unknown message type: %s", message.c_str());
+
+  int16_t tone[TONE_BLOCK_SAMPLES];
+  size_t tone_samples = tone_.render(tone, TONE_BLOCK_SAMPLES);
+  for (size_t i = 0; i < tone_samples; i++) {
+    int32_t mixed = (i < stream_samples ? tone_block_[i] : 0) + tone[i];
+    tone_block_[i] = static_cast<int16_t>(std::max(-32768, std::min(32767, static_cast<int>(mixed))));
   }
+  tone_block_bytes_ = std::max(stream_samples, tone_samples) * sizeof(int16_t);
+  tone_block_offset_ = 0;
 }
 
-void USBCommunicationComponent::process_config_(const std::string &message) {
-  ESP_LOGI(TAG, "Processing configuration: %s", message.c_str());
-  
-  // Handle unmute request
-  if (message.find("\"unmute\":true") != std::string::npos) {
-    ESP_LOGI(TAG, "Unmuting device via config");
-    // This will be handled by YAML automation based on the flag
-    unmute_requested_ = true;
+void USBCommunicationComponent::begin_playback_() {
+  if (target_speaker_ == nullptr) {
+    ESP_LOGE(TAG, "No speaker configured! Cannot play audio.");
+    return;
   }
-  
-  // Handle volume setting
-  if (message.find("\"volume\":") != std::string::npos) {
-    size_t vol_pos = message.find("\"volume\":");
-    if (vol_pos != std::string::npos) {
-      vol_pos += 9; // Skip "volume":
-      size_t end_pos = message.find(",", vol_pos);
-      if (end_pos == std::string::npos) end_pos = message.find("}", vol_pos);
-      if (end_pos != std::string::npos) {
-        std::string vol_str = message.substr(vol_pos, end_pos - vol_pos);
-        requested_volume_ = std::stof(vol_str);
-        ESP_LOGI(TAG, "Setting volume to: %f", requested_volume_);
-        volume_change_requested_ = true;
+
+  ESP_LOGI(TAG, "Starting speaker playback with %zu bytes buffered", usb_audio_buffer_size_);
+  this->run_on_main_loop_(COMMAND_SPEAKER_START);
+  playback_state_ = PLAYBACK_PLAYING;
+  this->feed_speaker_();
+}
+
+void USBCommunicationComponent::feed_speaker_() {
+  // While a tone plays, audio goes through tone_block_ so the tone can be mixed in; the remainder of a block the
+  // speaker did not take is kept for the next call
+  while (tone_playing_) {
+    if (tone_block_offset_ == tone_block_bytes_) {
+      if (!tone_.active()) {
+        break;
       }
+      this->stage_speaker_block_();
+    }
+    size_t pending = tone_block_bytes_ - tone_block_offset_;
+    size_t written = this->play_speaker_(reinterpret_cast<const uint8_t *>(tone_block_) + tone_block_offset_, pending);
+    tone_block_offset_ += written;
+    if (written < pending) {
+      return;
+    }
+  }
+  if (tone_playing_) {
+    tone_playing_ = false;
+    this->send_response_("tone_complete");
+    if (playback_state_ == PLAYBACK_IDLE) {
+      this->run_on_main_loop_(COMMAND_SPEAKER_FINISH);
     }
   }
-  
-  // Simple JSON parsing for configuration
-  if (message.find("\"wake_word\":") != std::string::npos) {
-    // Extract wake word value
-    size_t start = message.find("\"wake_word\":\"") + 13;
-    size_t end = message.find("\"", start);
-    if (start != std::string::npos && end != std::string::npos) {
-      std::string new_wake_word = message.substr(start, end - start);
-      ESP_LOGD(TAG, "Setting wake word to: %s", new_wake_word.c_str());
-      current_wake_word_ = new_wake_word;
-      
-      // Enable/disable the appropriate wake word models
-      // Note: This will be handled via YAML interval that calls the micro_wake_word API
-    }
-  }
-  
-  if (message.find("\"sensitivity\":") != std::string::npos) {
-    // Extract sensitivity value
-    size_t start = message.find("\"sensitivity\":\"") + 15;
-    size_t end = message.find("\"", start);
-    if (start != std::string::npos && end != std::string::npos) {
-      std::string new_sensitivity = message.substr(start, end - start);
-      ESP_LOGD(TAG, "Setting sensitivity to: %s", new_sensitivity.c_str());
-      current_sensitivity_ = new_sensitivity;
-      
-      // For now, just store the sensitivity value
-      // The actual application to the wake word component will be handled
-      // via YAML actions triggered by the status response
-    }
-  }
-  
-  if (message.find("\"voice_phase\":") != std::string::npos) {
-    // Extract voice assistant phase (for LED control)
-    size_t start = message.find("\"voice_phase\":\"") + 15;
-    size_t end = message.find("\"", start);
-    if (start != std::string::npos && end != std::string::npos) {
-      std::string phase_name = message.substr(start, end - start);
-      ESP_LOGD(TAG, "Setting voice phase to: %s", phase_name.c_str());
-      
-      // Map phase names to phase IDs (defined in YAML substitutions)
-      int phase_id = 1; // default to idle
-      if (phase_name == "waiting") phase_id = 2;
-      else if (phase_name == "listening") phase_id = 3;
-      else if (phase_name == "thinking") phase_id = 4;
-      else if (phase_name == "replying") phase_id = 5;
-      else if (phase_name == "idle") phase_id = 1;
-      else if (phase_name == "error") phase_id = 11;
-      
-      current_voice_phase_ = phase_id;
-    }
-  }
-  
-  this->send_response_("config_received");
-}
 
-void USBCommunicationComponent::process_play_audio_(const std::string &message) {
-  ESP_LOGD(TAG, "Processing play audio request");
-  
-  // Check if this is part of a batch
-  bool is_batch = message.find("\"batch\":") != std::string::npos;
-  int batch_number = 1;
-  int total_batches = 1;
-  
-  if (is_batch) {
-    // Extract batch information
-    size_t batch_pos = message.find("\"batch\":");
-    if (batch_pos != std::string::npos) {
-      batch_pos += 8; // Skip "batch":
-      size_t end_pos = message.find(",", batch_pos);
-      if (end_pos == std::string::npos) end_pos = message.find("}", batch_pos);
-      if (end_pos != std::string::npos) {
-        std::string batch_str = message.substr(batch_pos, end_pos - batch_pos);
-        batch_number = std::stoi(batch_str);
-      }
+  // Hand the speaker as much as it accepts right now; play() never waits, so a full speaker simply
+  // leaves the rest for the next loop() iteration
+  while (usb_audio_buffer_size_ > 0 && playback_state_ != PLAYBACK_BUFFERING) {
+    size_t contiguous = std::min(usb_audio_buffer_size_, playback_buffer_size_ - usb_audio_buffer_read_index_);
+    size_t write_chunk = std::min(contiguous, SPEAKER_WRITE_CHUNK_SIZE);
+    size_t written = this->play_speaker_(usb_audio_buffer_ + usb_audio_buffer_read_index_, write_chunk);
+    if (written == 0) {
+      break;
     }
-    
-    size_t total_pos = message.find("\"total_batches\":");
-    if (total_pos != std::string::npos) {
-      total_pos += 16; // Skip "total_batches":
-      size_t end_pos = message.find(",", total_pos);
-      if (end_pos == std::string::npos) end_pos = message.find("}", total_pos);
-      if (end_pos != std::string::npos) {
-        std::string total_str = message.substr(total_pos, end_pos - total_pos);
-        total_batches = std::stoi(total_str);
-      }
+#ifdef USE_USB_COMMUNICATION_TRACE
+    if (trace_first_play_pending_) {
+      USB_TRACE_RECORD(trace_, TRACE_FIRST_PLAY, trace_stream_start_us_);
+      trace_first_play_pending_ = false;
     }
-    
-    ESP_LOGD(TAG, "Processing audio batch %d/%d", batch_number, total_batches);
-    
-    // Initialize streaming on first batch
-    if (batch_number == 1) {
-      ESP_LOGD(TAG, "Starting batched audio stream for %d total batches", total_batches);
-      this->start_audio_stream();
+#endif
+    usb_audio_buffer_read_index_ = (usb_audio_buffer_read_index_ + written) % playback_buffer_size_;
+    usb_audio_buffer_size_ -= written;
+    if (written < write_chunk) {
+      break;
     }
   }
-  
-  // Extract audio data from the message and parse it
-  if (message.find("\"audio_data\":[") != std::string::npos) {
-    ESP_LOGD(TAG, "Extracting audio data from play_audio message");
-    
-    // Find the audio_data array in the JSON
-    size_t data_start = message.find("\"audio_data\":[");
-    if (data_start != std::string::npos) {
-      data_start += 14; // Skip to after the opening bracket
-      size_t data_end = message.find("]", data_start);
-      if (data_end != std::string::npos) {
-        std::string audio_array = message.substr(data_start, data_end - data_start);
-        
-        // For non-batch messages, start streaming
-        if (!is_batch) {
-          this->start_audio_stream();
-        }
-        
-        // Parse comma-separated integers and stream to buffer
-        size_t pos = 0;
-        while (pos < audio_array.length()) {
-          size_t comma_pos = audio_array.find(",", pos);
-          if (comma_pos == std::string::npos) comma_pos = audio_array.length();
-          
-          std::string sample_str = audio_array.substr(pos, comma_pos - pos);
-          // Simple integer parsing without exceptions
-          char* endptr;
-          long sample = strtol(sample_str.c_str(), &endptr, 10);
-          if (endptr != sample_str.c_str() && *endptr == '\0') {
-            // Valid integer conversion - convert to bytes and stream
-            int16_t sample_16 = static_cast<int16_t>(std::max(-32768L, std::min(32767L, sample)));
-            uint8_t bytes[2] = {
-              static_cast<uint8_t>(sample_16 & 0xFF),
-              static_cast<uint8_t>((sample_16 >> 8) & 0xFF)
-            };
-            this->write_audio_chunk(bytes, 2);
-          }
-          pos = comma_pos + 1;
-        }
-        
-        ESP_LOGD(TAG, "Buffered audio batch %d data", batch_number);
-        
-        // Only finish stream and play on last batch or non-batch messages
-        if (!is_batch || batch_number >= total_batches) {
-          ESP_LOGD(TAG, "Finishing audio stream and triggering playback");
-          this->finish_audio_stream();
-          this->send_response_("audio_played");
-        } else {
-          ESP_LOGD(TAG, "Waiting for more batches before playback");
-          // Send acknowledgment that batch was received but don't trigger playback yet
-          this->send_response_("batch_received");
-        }
-      }
+
+  if (playback_state_ == PLAYBACK_DRAINING && usb_audio_buffer_size_ == 0) {
+    ESP_LOGI(TAG, "Finished streaming audio to speaker");
+    USB_TRACE_RECORD(trace_, TRACE_PLAYBACK_DRAIN, trace_stream_finish_us_);
+    if (!tone_playing_) {
+      this->run_on_main_loop_(COMMAND_SPEAKER_FINISH);
     }
-  } else {
-    ESP_LOGD(TAG, "No audio data found in play audio message");
+    playback_state_ = PLAYBACK_IDLE;
+
+    // Polled by should_play_audio(), and delivered to on_playback_complete from loop()
+    audio_trigger_pending_ = true;
+    playback_complete_event_pending_ = true;
+    this->send_response_("audio_playback_complete");
   }
 }
 
-void USBCommunicationComponent::process_play_audio_compressed_(const std::string &message) {
-  ESP_LOGD(TAG, "Processing compressed audio message");
-  
-  // Extract base64 audio data and sample count
-  if (message.find("\"audio_base64\":\"") != std::string::npos && message.find("\"sample_count\":") != std::string::npos) {
-    
-    // Extract sample count
-    size_t count_pos = message.find("\"sample_count\":");
-    if (count_pos != std::string::npos) {
-      count_pos += 15; // Skip "sample_count":
-      size_t end_pos = message.find(",", count_pos);
-      if (end_pos == std::string::npos) end_pos = message.find("}", count_pos);
-      if (end_pos != std::string::npos) {
-        std::string count_str = message.substr(count_pos, end_pos - count_pos);
-        int sample_count = std::stoi(count_str);
-        ESP_LOGD(TAG, "Compressed audio contains %d samples", sample_count);
-        
-        // Extract base64 data
-        size_t b64_start = message.find("\"audio_base64\":\"");
-        if (b64_start != std::string::npos) {
-          b64_start += 16; // Skip "audio_base64":"
-          size_t b64_end = message.find("\"", b64_start);
-          if (b64_end != std::string::npos) {
-            std::string base64_audio = message.substr(b64_start, b64_end - b64_start);
-            ESP_LOGD(TAG, "Base64 audio data length: %d characters", base64_audio.length());
-            
-            // Decode base64 - simple implementation for binary audio data
-            this->start_audio_stream();
-            
-            // For now, send a confirmation tone instead of trying to decode base64
-            // This confirms the messaging is working
-            ESP_LOGD(TAG, "Generating confirmation tone for compressed audio");
-            
-            // Generate a simple 440Hz tone for 100ms (1600 samples at 16kHz)
-            for (int i = 0; i < 1600; i++) {
-              float t = (float)i / 16000.0f;
-              int16_t sample = (int16_t)(16000.0f * sin(2.0f * 3.14159f * 440.0f * t));
-              uint8_t bytes[2] = {
-                static_cast<uint8_t>(sample & 0xFF),
-                static_cast<uint8_t>((sample >> 8) & 0xFF)
-              };
-              this->write_audio_chunk(bytes, 2);
-            }
-            
-            ESP_LOGD(TAG, "Finishing compressed audio stream");
-            this->finish_audio_stream();
-            this->send_response_("audio_played");
-          }
-        }
-      }
+size_t USBCommunicationComponent::play_speaker_(const uint8_t *data, size_t length) {
+  // Never waits: whatever the speaker, or the feed to it, cannot take right now is left to the caller
+  if (!this->on_pipeline_task_()) {
+    return target_speaker_->play(data, length, 0);
+  }
+  return speaker_feed_.write(data, std::min(length, speaker_feed_.free()));
+}
+
+void USBCommunicationComponent::drain_speaker_feed_() {
+  if (target_speaker_ == nullptr) {
+    return;
+  }
+  const uint8_t *data;
+  size_t length;
+  while ((length = speaker_feed_.peek(&data)) > 0) {
+    size_t written = target_speaker_->play(data, length, 0);
+    speaker_feed_.consume(written);
+    if (written < length) {
+      break;
     }
-  } else {
-    ESP_LOGD(TAG, "No compressed audio data found in message");
+  }
+  if (speaker_finish_pending_ && speaker_feed_.available() == 0) {
+    speaker_finish_pending_ = false;
+    target_speaker_->finish();
   }
 }
 
-void USBCommunicationComponent::process_play_tone_(const std::string &message) {
-  ESP_LOGI(TAG, "***** PROCESSING PLAY TONE MESSAGE *****");
-  
-  // Extract frequency and duration (for logging purposes)
-  int frequency = 440; // Default
-  int duration_ms = 500; // Default
-  
-  // Extract frequency
-  size_t freq_pos = message.find("\"frequency\":");
-  if (freq_pos != std::string::npos) {
-    freq_pos += 12; // Skip "frequency":
-    size_t end_pos = message.find(",", freq_pos);
-    if (end_pos == std::string::npos) end_pos = message.find("}", freq_pos);
-    if (end_pos != std::string::npos) {
-      std::string freq_str = message.substr(freq_pos, end_pos - freq_pos);
-      frequency = std::stoi(freq_str);
-    }
-  }
-  
-  // Extract duration
-  size_t dur_pos = message.find("\"duration_ms\":");
-  if (dur_pos != std::string::npos) {
-    dur_pos += 14; // Skip "duration_ms":
-    size_t end_pos = message.find(",", dur_pos);
-    if (end_pos == std::string::npos) end_pos = message.find("}", dur_pos);
-    if (end_pos != std::string::npos) {
-      std::string dur_str = message.substr(dur_pos, end_pos - dur_pos);
-      duration_ms = std::stoi(dur_str);
-    }
-  }
-  
-  ESP_LOGI(TAG, "Requested %dHz tone for %dms - triggering factory firmware sound playback", frequency, duration_ms);
-  
-  // Set a flag that the YAML can check to trigger sound playback using factory firmware method
-  tone_playback_requested_ = true;
-  
-  // The YAML will detect this flag and call the play_sound script with an existing sound file
-  // This uses the exact same audio pipeline as the factory firmware
-  
-  this->send_response_("audio_played");
+void USBCommunicationComponent::process_clip_upload_begin_(const JsonMessage &message) {
+  std::string_view id = message.get_string("id");
+  std::string_view hash = message.get_string("hash");
+  uint32_t size = message.get_int<uint32_t>("size", 0);
+  uint32_t sample_rate = message.get_int<uint32_t>("sample_rate", this->speaker_sample_rate_());
+  const char *error = nullptr;
+  if (clip_cache_.capacity() == 0) {
+    error = "disabled";
+  } else if (id.empty() || id.size() > ClipCache::MAX_ID_LENGTH || hash.size() > ClipCache::MAX_HASH_LENGTH ||
+             size == 0 || size % sizeof(int16_t) != 0) {
+    error = "invalid";
+  } else if (size > clip_cache_.capacity()) {
+    error = "too_large";
+  } else if (clip_cache_.begin(id, hash, size, sample_rate, clip_play_slot_) == ClipCache::NO_CLIP) {
+    // Only the clip that is playing right now can be in the way
+    error = "busy";
+  }
+  if (error != nullptr) {
+    ESP_LOGW(TAG, "Clip upload rejected: %s", error);
+    this->send_clip_error_(id, error);
+    return;
+  }
+
+  ESP_LOGD(TAG, "Receiving %u byte clip '%.*s'", (unsigned) size, static_cast<int>(id.size()), id.data());
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"clip_upload_ready\",\"id\":\"";
+  response.append(id.data(), id.size());
+  response += "\",\"size\":";
+  response += std::to_string(size);
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
 }
 
-void USBCommunicationComponent::process_play_audio_chunk_(const std::string &message) {
-  ESP_LOGD(TAG, "Processing audio chunk: %s", message.c_str());
-  
-  // Parse chunk information
-  bool is_start = message.find("\"is_start\":true") != std::string::npos;
-  
-  if (is_start) {
-    // Initialize new audio reception
-    ESP_LOGD(TAG, "Starting new chunked audio reception");
-    audio_chunks_.clear();
-    received_chunks_ = 0;
-    expected_total_chunks_ = 0;
-    this->start_audio_stream();
-    
-    // Extract total chunks count
-    size_t total_pos = message.find("\"total_chunks\":");
-    if (total_pos != std::string::npos) {
-      total_pos += 15; // Skip "total_chunks":
-      size_t end_pos = message.find(",", total_pos);
-      if (end_pos == std::string::npos) end_pos = message.find("}", total_pos);
-      if (end_pos != std::string::npos) {
-        std::string total_str = message.substr(total_pos, end_pos - total_pos);
-        expected_total_chunks_ = std::stoi(total_str);
-        audio_chunks_.resize(expected_total_chunks_);
-        ESP_LOGD(TAG, "Expecting %d audio chunks", expected_total_chunks_);
-      }
-    }
+void USBCommunicationComponent::receive_clip_data_(const FrameHeader &header, const uint8_t *payload) {
+  int slot = clip_cache_.receiving();
+  if (slot == ClipCache::NO_CLIP || header.length < CLIP_FRAME_HEADER_SIZE) {
+    ESP_LOGW(TAG, "Clip frame %u without an active upload", header.sequence);
+    this->send_frame_error_("state", header.sequence);
     return;
   }
-  
-  // Extract chunk index
-  int chunk_index = -1;
-  size_t index_pos = message.find("\"chunk_index\":");
-  if (index_pos != std::string::npos) {
-    index_pos += 14; // Skip "chunk_index":
-    size_t end_pos = message.find(",", index_pos);
-    if (end_pos != std::string::npos) {
-      std::string index_str = message.substr(index_pos, end_pos - index_pos);
-      chunk_index = std::stoi(index_str);
-    }
-  }
-  
-  // Extract audio data if present
-  if (message.find("\"audio_data\":[") != std::string::npos && chunk_index > 0) {
-    ESP_LOGD(TAG, "Received audio chunk %d/%d", chunk_index, expected_total_chunks_);
-    
-    // Extract actual audio data from JSON array
-    if (chunk_index <= expected_total_chunks_ && chunk_index > 0) {
-      // Find the audio_data array in the JSON
-      size_t data_start = message.find("\"audio_data\":[");
-      if (data_start != std::string::npos) {
-        data_start += 14; // Skip to after the opening bracket
-        size_t data_end = message.find("]", data_start);
-        if (data_end != std::string::npos) {
-          std::string audio_array = message.substr(data_start, data_end - data_start);
-          
-          // Parse comma-separated integers
-          std::vector<int> chunk_samples;
-          size_t pos = 0;
-          while (pos < audio_array.length()) {
-            size_t comma_pos = audio_array.find(",", pos);
-            if (comma_pos == std::string::npos) comma_pos = audio_array.length();
-            
-            std::string sample_str = audio_array.substr(pos, comma_pos - pos);
-            // Simple integer parsing without exceptions
-            char* endptr;
-            long sample = strtol(sample_str.c_str(), &endptr, 10);
-            if (endptr != sample_str.c_str() && *endptr == '\0') {
-              // Valid integer conversion
-              chunk_samples.push_back(static_cast<int>(sample));
-            }
-            pos = comma_pos + 1;
-          }
-          
-          // Store chunk samples
-          audio_chunks_[chunk_index - 1] = chunk_samples;
-          received_chunks_++;
-          
-          ESP_LOGD(TAG, "Audio chunk %d received with %d samples (%d/%d total chunks)", 
-                   chunk_index, chunk_samples.size(), received_chunks_, expected_total_chunks_);
-        }
-      }
-      
-      // Check if all chunks received
-      if (received_chunks_ >= expected_total_chunks_) {
-        ESP_LOGD(TAG, "All audio chunks received! Assembling complete audio");
-        
-        // Stream all chunks to audio buffer
-        ESP_LOGD(TAG, "All chunks received, streaming to audio buffer");
-        for (const auto& chunk : audio_chunks_) {
-          for (int sample : chunk) {
-            // Convert from int to int16_t and stream as bytes
-            int16_t sample_16 = static_cast<int16_t>(std::max(-32768, std::min(32767, sample)));
-            uint8_t bytes[2] = {
-              static_cast<uint8_t>(sample_16 & 0xFF),
-              static_cast<uint8_t>((sample_16 >> 8) & 0xFF)
-            };
-            this->write_audio_chunk(bytes, 2);
-          }
-        }
-        
-        ESP_LOGD(TAG, "Finished streaming chunked audio");
-        
-        // Finish the stream and trigger playback
-        this->finish_audio_stream();
-        this->send_response_("audio_played");
-        
-        // Reset for next audio
-        audio_chunks_.clear();
-        received_chunks_ = 0;
-        expected_total_chunks_ = 0;
-      }
-    }
+  uint32_t offset;
+  memcpy(&offset, payload, sizeof(uint32_t));
+  if (offset != clip_cache_.received() ||
+      !clip_cache_.append(payload + CLIP_FRAME_HEADER_SIZE, header.length - CLIP_FRAME_HEADER_SIZE)) {
+    // A lost or repeated frame leaves a hole the host has to fill by uploading again
+    std::string id(clip_cache_.id(slot));
+    ESP_LOGW(TAG, "Clip '%s' frame at offset %u does not follow %zu bytes, aborting upload", id.c_str(),
+             (unsigned) offset, clip_cache_.received());
+    clip_cache_.abort();
+    this->send_clip_error_(id, "gap");
+    return;
+  }
+  if (clip_cache_.receiving() != ClipCache::NO_CLIP) {
+    return;
   }
+
+  ESP_LOGI(TAG, "Cached clip '%s' (%zu bytes)", clip_cache_.id(slot), clip_cache_.size(slot));
+  std::string response;
+  response.reserve(192);
+  response += "{\"type\":\"clip_stored\",\"id\":\"";
+  response += clip_cache_.id(slot);
+  response += "\",\"hash\":\"";
+  response += clip_cache_.hash(slot);
+  response += "\",\"size\":";
+  response += std::to_string(clip_cache_.size(slot));
+  response += ",\"clips\":";
+  response += std::to_string(clip_cache_.count());
+  response += ",\"cache_free\":";
+  response += std::to_string(clip_cache_.capacity() - clip_cache_.used());
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
 }
 
-void USBCommunicationComponent::send_status_update_() {
-  // Build JSON more carefully to avoid corruption
-  std::string status;
-  status.reserve(512);  // Reserve enough space
-  
-  status += "{";
-  status += "\"type\":\"status\",";
-  status += "\"timestamp\":";
-  status += std::to_string(millis());
-  status += ",";
-  status += "\"wake_word_active\":false,";
-  status += "\"microphone_muted\":false,";
-  status += "\"voice_assistant_phase\":";
-  status += std::to_string(current_voice_phase_);
-  status += ",";
-  status += "\"voice_assistant_running\":true,";
-  status += "\"timer_active\":false,";
-  status += "\"timer_ringing\":false,";
-  status += "\"led_brightness\":0.66,";
-  status += "\"volume\":0.7,";
-  status += "\"wake_word\":\"";
-  status += current_wake_word_;
-  status += "\",";
-  status += "\"wake_word_sensitivity\":\"";
-  status += current_sensitivity_;
-  status += "\",";
-  status += "\"wifi_connected\":false,";
-  status += "\"api_connected\":false";
-  status += "}";
-  
-  this->send_json_(status);
+void USBCommunicationComponent::process_has_clip_(const JsonMessage &message) {
+  // Without a hash any clip with the ID counts; the reply carries the stored hash either way
+  std::string_view id = message.get_string("id");
+  std::string_view hash = message.get_string("hash");
+  int slot = clip_cache_.find(id);
+  bool cached = slot != ClipCache::NO_CLIP && (hash.empty() || clip_cache_.has(id, hash));
+
+  std::string response;
+  response.reserve(160);
+  response += "{\"type\":\"clip_status\",\"id\":\"";
+  response.append(id.data(), id.size());
+  response += "\",\"cached\":";
+  response += cached ? "true" : "false";
+  if (slot != ClipCache::NO_CLIP) {
+    response += ",\"hash\":\"";
+    response += clip_cache_.hash(slot);
+    response += "\"";
+  }
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
 }
 
-void USBCommunicationComponent::send_wake_word_options_() {
-  // Wake word options based on the ESPHome configuration
-  // These match the wake words loaded in the micro_wake_word component
-  std::string options;
-  options.reserve(256);
-  
-  options += "{";
-  options += "\"type\":\"wake_word_options\",";
-  options += "\"options\":[\"Okay Nabu\",\"Hey Jarvis\",\"Hey Mycroft\",\"Stop\"],";
-  options += "\"timestamp\":";
-  options += std::to_string(millis());
-  options += "}";
-  
-  this->send_json_(options);
+void USBCommunicationComponent::process_play_clip_(const JsonMessage &message) {
+  std::string_view id = message.get_string("id");
+  int slot = clip_cache_.find(id);
+  uint32_t output_rate = this->speaker_sample_rate_();
+  const char *error = nullptr;
+  if (slot == ClipCache::NO_CLIP) {
+    error = "not_cached";
+  } else if (target_speaker_ == nullptr) {
+    error = "no_speaker";
+  } else if (is_streaming_audio_ && clip_play_slot_ == ClipCache::NO_CLIP) {
+    // A host stream is open; a clip only interrupts another clip
+    error = "busy";
+  } else if (clip_cache_.sample_rate(slot) != output_rate &&
+             !resampler_.configure(clip_cache_.sample_rate(slot), output_rate)) {
+    error = "unsupported_sample_rate";
+  }
+  if (error != nullptr) {
+    ESP_LOGW(TAG, "Cannot play clip '%.*s': %s", static_cast<int>(id.size()), id.data(), error);
+    this->send_clip_error_(id, error);
+    return;
+  }
+
+  this->start_audio_stream();
+  stream_sample_rate_ = clip_cache_.sample_rate(slot);
+  resampling_ = stream_sample_rate_ != output_sample_rate_;
+  clip_cache_.touch(slot);
+  clip_play_slot_ = slot;
+  clip_play_offset_ = 0;
+
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"clip_started\",\"id\":\"";
+  response.append(id.data(), id.size());
+  response += "\",\"size\":";
+  response += std::to_string(clip_cache_.size(slot));
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+  this->pump_clip_();
 }
 
-void USBCommunicationComponent::send_response_(const char* response_type) {
+void USBCommunicationComponent::pump_clip_() {
+  // finish_audio_stream from the host ends the clip like any other stream
+  if (!is_streaming_audio_) {
+    clip_play_slot_ = ClipCache::NO_CLIP;
+    return;
+  }
+  // Only what the playback buffer can take right now, allowing for everything the resampler may produce
+  const uint8_t *data = clip_cache_.data(clip_play_slot_);
+  size_t size = clip_cache_.size(clip_play_slot_);
+  while (clip_play_offset_ < size) {
+    size_t block = std::min(size - clip_play_offset_, CLIP_PUMP_BYTES);
+    size_t needed = resampling_ ? resampler_.max_output(block / sizeof(int16_t)) * sizeof(int16_t) : block;
+    if (playback_buffer_size_ - usb_audio_buffer_size_ < needed) {
+      return;
+    }
+    this->write_audio_chunk(data + clip_play_offset_, block);
+    clip_play_offset_ += block;
+  }
+  clip_play_slot_ = ClipCache::NO_CLIP;
+  this->finish_audio_stream();
+}
+
+void USBCommunicationComponent::send_clip_error_(std::string_view id, const char *reason) {
   std::string response;
   response.reserve(128);
-  
-  response += "{\"type\":\"";
-  response += response_type;
+  response += "{\"type\":\"clip_error\",\"id\":\"";
+  response.append(id.data(), id.size());
+  response += "\",\"reason\":\"";
+  response += reason;
   response += "\",\"timestamp\":";
   response += std::to_string(millis());
   response += "}";
-  
   this->send_json_(response);
 }
 
-void USBCommunicationComponent::send_json_(const std::string &json) {
-  // Send JSON via USB Serial/JTAG using printf
-  printf("%s\n", json.c_str());
-  fflush(stdout);
+// Microphone capture methods
+void USBCommunicationComponent::process_xmos_update_begin_(const JsonMessage &message) {
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  const char *error = nullptr;
+  uint32_t length = message.get_int<uint32_t>("size", 0);
+  unsigned major = 0, minor = 0, patch = 0;
+  std::string version(message.get_string("version"));
+  if (voice_kit_ == nullptr) {
+    error = "unavailable";
+  } else if (!voice_kit_->is_xmos_ready() && !voice_kit_->is_streamed_update_active()) {
+    error = "not_ready";
+  } else if (xmos_update_active_) {
+    error = "busy";
+  } else if (length == 0 || !message.has("crc32") ||
+             sscanf(version.c_str(), "%u.%u.%u", &major, &minor, &patch) != 3) {
+    error = "invalid";
+  } else if (!voice_kit_->begin_streamed_update(length, message.get_int<uint32_t>("crc32", 0), major, minor,
+                                                patch)) {
+    error = "rejected";
+  }
+  if (error == nullptr) {
+    // Leftovers of an earlier, aborted transfer must not end up in this image
+    xmos_update_ring_.consume(xmos_update_ring_.available());
+    xmos_update_dropped_base_ = xmos_update_ring_.dropped();
+    xmos_update_length_ = length;
+    xmos_update_forwarded_ = 0;
+    xmos_update_active_ = true;
+    ESP_LOGI(TAG, "Host is streaming a %u byte XMOS image (%s)", (unsigned) length, version.c_str());
+    this->send_xmos_update_credit_("xmos_update_started");
+    return;
+  }
+#else
+  const char *error = "unavailable";
+#endif
+  ESP_LOGW(TAG, "XMOS update rejected: %s", error);
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"xmos_update_error\",\"reason\":\"";
+  response += error;
+  response += "\",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
 }
 
-void USBCommunicationComponent::process_audio_data_chunk_(const std::string &message) {
-  // Extract binary audio data from JSON array and write to stream buffer
-  if (message.find("\"data\":[") != std::string::npos) {
-    // Find the data array in the JSON
-    size_t data_start = message.find("\"data\":[");
-    if (data_start != std::string::npos) {
-      data_start += 8; // Skip to after the opening bracket
-      size_t data_end = message.find("]", data_start);
-      if (data_end != std::string::npos) {
-        std::string data_array = message.substr(data_start, data_end - data_start);
-        
-        // Parse comma-separated integers and convert to bytes
-        std::vector<uint8_t> chunk_bytes;
-        size_t pos = 0;
-        while (pos < data_array.length()) {
-          size_t comma_pos = data_array.find(",", pos);
-          if (comma_pos == std::string::npos) comma_pos = data_array.length();
-          
-          std::string byte_str = data_array.substr(pos, comma_pos - pos);
-          char* endptr;
-          long byte_val = strtol(byte_str.c_str(), &endptr, 10);
-          if (endptr != byte_str.c_str() && *endptr == '\0') {
-            // Valid integer conversion
-            chunk_bytes.push_back(static_cast<uint8_t>(byte_val & 0xFF));
-          }
-          pos = comma_pos + 1;
-        }
-        
-        ESP_LOGD(TAG, "Received audio data chunk with %d bytes", chunk_bytes.size());
-        
-        // Write chunk to streaming buffer
-        if (!chunk_bytes.empty()) {
-          this->write_audio_chunk(chunk_bytes.data(), chunk_bytes.size());
-        }
-      }
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+void USBCommunicationComponent::service_xmos_update_() {
+  if (xmos_update_ring_.dropped() != xmos_update_dropped_base_) {
+    ESP_LOGE(TAG, "XMOS image overran its credit");
+    voice_kit_->abort_streamed_update();  // reported through on_voice_kit_state_()
+    xmos_update_dropped_base_ = xmos_update_ring_.dropped();
+    return;
+  }
+
+  // Hand over as much as the DFU staging buffer takes; the rest waits in the ring
+  const uint8_t *data;
+  size_t length;
+  while ((length = xmos_update_ring_.peek(&data)) > 0) {
+    size_t accepted = voice_kit_->write_update_data(data, length);
+    if (accepted == 0) {
+      break;
     }
+    xmos_update_ring_.consume(accepted);
+    xmos_update_forwarded_ += accepted;
+  }
+
+  uint32_t limit = std::min<uint32_t>(xmos_update_length_, xmos_update_forwarded_ + XMOS_UPDATE_RING_SIZE);
+  uint32_t now = millis();
+  if (limit - xmos_credit_sent_limit_ >= CREDIT_MIN_GRANT || now - xmos_last_credit_time_ >= CREDIT_INTERVAL_MS) {
+    this->send_xmos_update_credit_("xmos_update_credit");
   }
 }
 
-// USB Audio streaming methods (replicating voice assistant architecture)
-void USBCommunicationComponent::start_audio_stream() {
-  ESP_LOGD(TAG, "Starting USB audio stream");
-  usb_audio_buffer_index_ = 0;
-  usb_audio_buffer_size_ = 0;
-  is_streaming_audio_ = true;
+bool USBCommunicationComponent::vnr_gate_closed_() const {
+  // Stays open while speech is present and for the hangover after it, so word endings are not clipped
+  return vnr_gate_enabled_ && !vnr_voice_ && millis() - vnr_quiet_since_ms_ >= vnr_gate_hangover_ms_;
 }
 
-void USBCommunicationComponent::write_audio_chunk(const uint8_t *data, size_t length) {
-  if (!is_streaming_audio_) {
-    ESP_LOGW(TAG, "Attempted to write audio chunk without starting stream");
-    return;
+void USBCommunicationComponent::send_xmos_update_credit_(const char *response_type) {
+  // limit is cumulative, counted in image bytes since xmos_update_begin
+  uint32_t limit = std::min<uint32_t>(xmos_update_length_, xmos_update_forwarded_ + XMOS_UPDATE_RING_SIZE);
+  std::string response;
+  response.reserve(96);
+  response += "{\"type\":\"";
+  response += response_type;
+  response += "\",\"limit\":";
+  response += std::to_string(limit);
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+  xmos_credit_sent_limit_ = limit;
+  xmos_last_credit_time_ = millis();
+}
+
+void USBCommunicationComponent::on_voice_kit_state_(voice_kit::DFUAutomationState state, float progress,
+                                                    voice_kit::VoiceKitUpdaterStatus status) {
+  // Embedded-image updates are reported too, so the host can tell why the XMOS went quiet
+  std::string response;
+  response.reserve(128);
+  switch (state) {
+    case voice_kit::DFU_START:
+      return;
+    case voice_kit::DFU_IN_PROGRESS: {
+      char progress_fields[64];
+      snprintf(progress_fields, sizeof(progress_fields), ",\"progress\":%.1f,\"kbps\":%.1f", progress,
+               voice_kit_->get_dfu_transfer_rate());
+      response += "{\"type\":\"xmos_update_progress\"";
+      response += progress_fields;
+      break;
+    }
+    case voice_kit::DFU_COMPLETE:
+      xmos_update_active_ = false;
+      response += "{\"type\":\"xmos_update_complete\"";
+      break;
+    case voice_kit::DFU_ERROR:
+      xmos_update_active_ = false;
+      response += "{\"type\":\"xmos_update_error\",\"reason\":\"failed\",\"status\":";
+      response += std::to_string(status);
+      break;
   }
-  
-  // Check buffer space (same as voice assistant)
-  if (usb_audio_buffer_index_ + length > USB_AUDIO_BUFFER_SIZE) {
-    ESP_LOGW(TAG, "USB audio buffer overflow, dropping chunk");
-    return;
+  response += ",\"timestamp\":";
+  response += std::to_string(millis());
+  response += "}";
+  this->send_json_(response);
+}
+#endif
+
+void USBCommunicationComponent::set_microphone(microphone::Microphone *microphone) {
+  source_microphone_ = microphone;
+  ESP_LOGI(TAG, "Microphone reference set: %p", microphone);
+
+  if (microphone != nullptr && !mic_callback_registered_) {
+    microphone->add_data_callback([this](const std::vector<uint8_t> &data) { this->on_microphone_data_(data); });
+    mic_callback_registered_ = true;
   }
-  
-  // Copy audio data to buffer (replicating voice assistant buffer management)
-  memcpy(usb_audio_buffer_ + usb_audio_buffer_index_, data, length);
-  usb_audio_buffer_index_ += length;
-  usb_audio_buffer_size_ += length;
-  
-  ESP_LOGD(TAG, "Wrote %d bytes to USB audio buffer (total: %d/%d)", 
-           length, usb_audio_buffer_size_, USB_AUDIO_BUFFER_SIZE);
 }
 
-void USBCommunicationComponent::finish_audio_stream() {
-  ESP_LOGD(TAG, "Finishing USB audio stream - %d bytes total", usb_audio_buffer_size_);
-  is_streaming_audio_ = false;
-  
-  if (target_speaker_ == nullptr) {
-    ESP_LOGE(TAG, "No speaker configured! Cannot play audio.");
+void USBCommunicationComponent::on_microphone_data_(const std::vector<uint8_t> &data) {
+  // Runs on the microphone task: convert and hand off, never touch the USB port from here
+  bool capturing = is_capturing_audio_ && mic_ring_buffer_ != nullptr;
+  bool preroll = preroll_.capacity() > 0;
+  if (!capturing && !preroll) {
     return;
   }
-  
-  if (usb_audio_buffer_size_ == 0) {
-    ESP_LOGW(TAG, "No audio data to play");
-    return;
-  }
-  
-  ESP_LOGI(TAG, "***** STARTING DIRECT SPEAKER PLAYBACK OF %d BYTES *****", usb_audio_buffer_size_);
-  
-  // FIRST: Try to force the speaker to start if it's not already started
-  ESP_LOGI(TAG, "Attempting to start speaker");
-  target_speaker_->start();
-  
-  // Stream audio to speaker using smaller chunks for better control
-  static const size_t CHUNK_SIZE = 512;  // Much smaller chunks
-  size_t bytes_remaining = usb_audio_buffer_size_;
-  size_t offset = 0;
-  
-  ESP_LOGI(TAG, "Streaming %d bytes to speaker in %d-byte chunks", 
-           usb_audio_buffer_size_, CHUNK_SIZE);
-  
-  while (bytes_remaining > 0) {
-    size_t write_chunk = std::min(bytes_remaining, CHUNK_SIZE);
-    
-    ESP_LOGI(TAG, "About to write %d bytes at offset %d", write_chunk, offset);
-    size_t written = target_speaker_->play(usb_audio_buffer_ + offset, write_chunk);
-    ESP_LOGI(TAG, "Successfully wrote %d/%d bytes to speaker", written, write_chunk);
-    
-    if (written == 0) {
-      ESP_LOGE(TAG, "Speaker write returned 0 - speaker may be stopped or full");
-      // Try to restart the speaker
-      target_speaker_->stop();
-      delay(10);
-      target_speaker_->start();
-      delay(10);
-      // Try again
-      written = target_speaker_->play(usb_audio_buffer_ + offset, write_chunk);
-      ESP_LOGI(TAG, "After restart, wrote %d bytes", written);
-    }
-    
-    offset += written;
-    bytes_remaining -= written;
-    
-    // If we couldn't write the full chunk, the speaker buffer is full
-    if (written < write_chunk) {
-      ESP_LOGI(TAG, "Partial write - speaker buffer constraints, remaining %d bytes", bytes_remaining);
-      // Small delay to let speaker process
-      delay(5);
+  USB_TRACE_MARK(callback_start);
+
+  uint32_t now = millis();
+  if (preroll && now - preroll_last_write_ms_ > PREROLL_GAP_MS) {
+    // The microphone was stopped in between; audio from before the gap is not pre-roll for anything happening now
+    preroll_.clear();
+  }
+  preroll_last_write_ms_ = now;
+
+  bool stereo = capturing && capture_mode_.load(std::memory_order_relaxed) != UPLINK_MONO;
+  if (capturing && preroll_flush_pending_.exchange(false)) {
+    // The history goes in ahead of this callback's audio, so the uplink opens with a burst of what preceded its
+    // trigger instead of waiting for new audio to accumulate
+    mic_ring_buffer_->reset();
+    preroll_.for_each_span([this](const int16_t *samples, size_t count) {
+      mic_ring_buffer_->write(samples, count * sizeof(int16_t));
+    });
+    mic_capture_start_ms_.store(now - preroll_.available() / 16, std::memory_order_relaxed);
+  }
+
+  // I2S delivers 32-bit stereo frames with the sample in the upper bits; keep the configured channel as 16-bit mono,
+  // or both channels interleaved when the uplink needs them
+  const int32_t *frames = reinterpret_cast<const int32_t *>(data.data());
+  size_t frame_count = data.size() / (2 * sizeof(int32_t));
+  int16_t converted[MIC_CONVERT_BLOCK_SAMPLES];
+  int16_t mono[MIC_CONVERT_BLOCK_SAMPLES / 2];
+  uint16_t peak = 0;
+  size_t max_block = stereo ? MIC_CONVERT_BLOCK_SAMPLES / 2 : MIC_CONVERT_BLOCK_SAMPLES;
+
+  while (frame_count > 0) {
+    size_t block = std::min(frame_count, max_block);
+    if (stereo) {
+      peak = std::max(peak, convert_i2s_stereo_to_interleaved(frames, block, converted));
+      // The pre-roll stays mono whatever the uplink is carrying
+      if (preroll) {
+        convert_i2s_stereo_to_mono(frames, block, mic_channel_, mono);
+        preroll_.write(mono, block);
+      }
+    } else {
+      peak = std::max(peak, convert_i2s_stereo_to_mono(frames, block, mic_channel_, converted));
+      if (preroll) {
+        preroll_.write(converted, block);
+      }
+    }
+    if (capturing) {
+      // Overwrites the oldest audio if loop() falls behind, so the host always gets the most recent audio
+      mic_ring_buffer_->write(converted, block * (stereo ? 2 : 1) * sizeof(int16_t));
     }
-    
-    // Small delay between chunks to avoid overwhelming the speaker
-    delay(1);
+    frames += 2 * block;
+    frame_count -= block;
+  }
+  if (capturing) {
+    mic_peak_level_.store(peak, std::memory_order_relaxed);
+  }
+  USB_TRACE_RECORD(trace_, TRACE_MIC_CALLBACK, callback_start);
+#ifdef USE_USB_COMMUNICATION_TRACE
+  trace_mic_callback_us_.store(micros(), std::memory_order_relaxed);
+#endif
+}
+
+void USBCommunicationComponent::send_microphone_frames_() {
+  // Large enough for a stereo frame; the auto mode reads stereo here and narrows it to mono in place
+  alignas(4) uint8_t payload[MIC_STEREO_FRAME_HEADER_SIZE + 2 * MIC_FRAME_SAMPLES * sizeof(int16_t)];
+  uint8_t mode = capture_mode_;
+  size_t frame_size = (mode == UPLINK_MONO ? 1 : 2) * sizeof(int16_t);
+  size_t header_size = mode == UPLINK_STEREO ? MIC_STEREO_FRAME_HEADER_SIZE : MIC_FRAME_HEADER_SIZE;
+  size_t sent_size = header_size + MIC_FRAME_SAMPLES * (mode == UPLINK_STEREO ? 2 : 1) * sizeof(int16_t);
+
+  // Frames wait in the mic ring rather than being dropped when the link is behind
+  while (mic_ring_buffer_->available() >= MIC_FRAME_SAMPLES * frame_size &&
+         tx_queue_.pending(TxQueue::PRIORITY_BULK) + FRAME_HEADER_SIZE + sent_size <= TX_BULK_LANE_SIZE / 2) {
+#ifdef USE_USB_COMMUNICATION_TRACE
+    // Oldest buffered sample: everything still queued plus the time since the last callback delivered audio
+    uint32_t queued_us = mic_ring_buffer_->available() / frame_size * 1000 / 16;
+    uint32_t since_callback_us = micros() - trace_mic_callback_us_.load(std::memory_order_relaxed);
+    USB_TRACE_RECORD_LATENCY(trace_, TRACE_MIC_TX, queued_us + since_callback_us);
+#endif
+    size_t bytes = mic_ring_buffer_->read(payload + header_size, MIC_FRAME_SAMPLES * frame_size, 0);
+    if (bytes == 0) {
+      break;
+    }
+    uint16_t samples = bytes / frame_size;
+
+    uint32_t timestamp_ms = mic_capture_start_ms_.load(std::memory_order_relaxed) + mic_sample_index_ / 16;
+    memcpy(payload, &mic_sample_index_, sizeof(uint32_t));
+    memcpy(payload + sizeof(uint32_t), &timestamp_ms, sizeof(uint32_t));
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+    if (this->vnr_gate_closed_()) {
+      // Room noise only: tell the host how much audio it is not getting so its timeline stays intact
+      memcpy(payload + MIC_FRAME_HEADER_SIZE, &samples, sizeof(uint16_t));
+      this->send_frame_(FRAME_TYPE_MIC_SILENCE, payload, MIC_FRAME_HEADER_SIZE + sizeof(uint16_t));
+      mic_sample_index_ += samples;
+      mic_frames_suppressed_++;
+      continue;
+    }
+#endif
+    if (mode == UPLINK_STEREO) {
+      payload[8] = mic_stages_[0].load(std::memory_order_relaxed);
+      payload[9] = mic_stages_[1].load(std::memory_order_relaxed);
+      payload[10] = 0;
+      payload[11] = 0;
+      this->send_frame_(FRAME_TYPE_MIC_AUDIO_STEREO, payload, header_size + bytes);
+    } else if (mode == UPLINK_AUTO) {
+      int16_t *audio = reinterpret_cast<int16_t *>(payload + header_size);
+      uint8_t channel = channel_selector_.process(audio, samples, this->uplink_voice_(), audio);
+      this->send_frame_(FRAME_TYPE_MIC_AUDIO, payload, header_size + samples * sizeof(int16_t),
+                        channel == 1 ? MIC_FRAME_FLAG_CHANNEL_1 : 0);
+    } else {
+      this->send_frame_(FRAME_TYPE_MIC_AUDIO, payload, header_size + bytes);
+    }
+
+    mic_sample_index_ += samples;
+    mic_frames_sent_++;
   }
-  
-  ESP_LOGI(TAG, "***** FINISHED STREAMING AUDIO TO SPEAKER *****");
-  
-  // Set flag for YAML interval to monitor completion
-  audio_trigger_pending_ = true;
 }
 
-// Microphone capture methods
 bool USBCommunicationComponent::capture_microphone_data(std::vector<int16_t> &buffer, size_t samples_needed) {
   if (source_microphone_ == nullptr) {
     ESP_LOGW(TAG, "No microphone configured for capture");
     return false;
   }
-  
+
   if (!is_capturing_audio_) {
     ESP_LOGW(TAG, "Microphone capture not started");
     return false;
   }
-  
-  // Try to read audio data from the microphone
-  // ESPHome microphones typically provide 32-bit samples
-  static std::vector<int32_t> raw_samples;
-  raw_samples.resize(samples_needed);
-  
-  // Use the microphone's read method (if available)
-  size_t samples_read = 0;
-  
-  // The microphone component should have a way to read samples
-  // This is a simplified approach - actual implementation depends on ESPHome's microphone API
-  ESP_LOGD(TAG, "Attempting to capture %zu samples from microphone", samples_needed);
-  
-  // For now, return false to indicate we couldn't get real data
-  // This will be improved once we understand the exact ESPHome microphone API
-  return false;
+
+  // The host uplink owns the capture buffer while it is running
+  if (mic_uplink_active_ || mic_ring_buffer_->available() < samples_needed * sizeof(int16_t)) {
+    return false;
+  }
+
+  buffer.resize(samples_needed);
+  size_t bytes = mic_ring_buffer_->read(buffer.data(), samples_needed * sizeof(int16_t), 0);
+  buffer.resize(bytes / sizeof(int16_t));
+  return !buffer.empty();
 }
 
 void USBCommunicationComponent::start_microphone_capture() {
-  if (source_microphone_ == nullptr) {
+  if (source_microphone_ == nullptr || mic_ring_buffer_ == nullptr) {
     ESP_LOGW(TAG, "Cannot start capture - no microphone configured");
     return;
   }
-  
+
   ESP_LOGI(TAG, "Starting microphone capture");
+  mic_ring_buffer_->reset();
+  mic_capture_start_ms_.store(millis(), std::memory_order_relaxed);
+  mic_sample_index_ = 0;
   is_capturing_audio_ = true;
-  
-  // Start the microphone if it has a start method
-  // source_microphone_->start();
+
+  // The microphone is shared with micro_wake_word; only start it (and later stop it) if nobody else has
+  if (source_microphone_->is_stopped()) {
+    source_microphone_->start();
+    mic_started_by_capture_ = true;
+  }
 }
 
 void USBCommunicationComponent::stop_microphone_capture() {
   ESP_LOGI(TAG, "Stopping microphone capture");
   is_capturing_audio_ = false;
-  
-  // Stop the microphone if it has a stop method
-  // source_microphone_->stop();
+  mic_uplink_active_ = false;
+  capture_mode_ = UPLINK_MONO;
+  preroll_flush_pending_ = false;
+
+  if (mic_started_by_capture_ && source_microphone_ != nullptr) {
+    source_microphone_->stop();
+    mic_started_by_capture_ = false;
+  }
 }
 
 // Audio data injection methods
@@ -819,47 +2436,58 @@ void USBCommunicationComponent::inject_audio_data(const int16_t* samples, size_t
   if (samples == nullptr || sample_count == 0) {
     return;
   }
-  
-  // Prevent buffer overflow
-  while (injected_audio_buffer_.size() + sample_count > MAX_INJECTED_AUDIO_BUFFER_SIZE) {
-    // Remove old samples from the front
-    size_t samples_to_remove = std::min(static_cast<size_t>(160), injected_audio_buffer_.size());
-    injected_audio_buffer_.erase(injected_audio_buffer_.begin(), injected_audio_buffer_.begin() + samples_to_remove);
-  }
-  
-  // Add new samples
-  for (size_t i = 0; i < sample_count; i++) {
-    injected_audio_buffer_.push_back(samples[i]);
+
+  // Never blocks: if the reader fell behind, whatever doesn't fit is dropped and counted by the ring
+  USB_TRACE_MARK(inject_start);
+  injected_audio_buffer_.write(samples, sample_count);
+  USB_TRACE_RECORD(trace_, TRACE_MIC_INJECT, inject_start);
+  last_audio_injection_time_.store(millis(), std::memory_order_relaxed);
+}
+
+void USBCommunicationComponent::inject_microphone_data(const std::vector<uint8_t> &data) {
+  const int32_t *frames = reinterpret_cast<const int32_t *>(data.data());
+  size_t frame_count = data.size() / (2 * sizeof(int32_t));
+  int16_t converted[MIC_CONVERT_BLOCK_SAMPLES];
+  uint16_t peak = 0;
+
+  while (frame_count > 0) {
+    size_t block = std::min(frame_count, MIC_CONVERT_BLOCK_SAMPLES);
+    peak = std::max(peak, convert_i2s_stereo_to_mono(frames, block, mic_channel_, converted));
+    this->inject_audio_data(converted, block);
+    frames += 2 * block;
+    frame_count -= block;
   }
-  
-  last_audio_injection_time_ = millis();
-  ESP_LOGD(TAG, "Injected %zu audio samples, buffer size: %zu", sample_count, injected_audio_buffer_.size());
+  mic_peak_level_.store(peak, std::memory_order_relaxed);
 }
 
 bool USBCommunicationComponent::has_recent_audio_data() const {
   unsigned long now = millis();
-  return (now - last_audio_injection_time_) < 100 && !injected_audio_buffer_.empty(); // 100ms timeout
+  return (now - last_audio_injection_time_.load(std::memory_order_relaxed)) < 100 &&
+         injected_audio_buffer_.available() > 0;  // 100ms timeout
 }
 
-void USBCommunicationComponent::get_latest_audio_data(std::vector<int16_t> &buffer, size_t samples_needed) {
-  buffer.clear();
-  buffer.resize(samples_needed, 0);
-  
-  if (injected_audio_buffer_.empty()) {
-    return;
+size_t USBCommunicationComponent::peek_latest_audio_data(const int16_t **samples, size_t samples_needed) {
+  // Skip older audio so the reader always gets the most recent samples
+  size_t available = injected_audio_buffer_.available();
+  if (available > samples_needed) {
+    injected_audio_buffer_.consume(available - samples_needed);
   }
-  
-  size_t samples_to_copy = std::min(samples_needed, injected_audio_buffer_.size());
-  
-  // Copy the most recent samples
-  if (injected_audio_buffer_.size() >= samples_to_copy) {
-    size_t start_index = injected_audio_buffer_.size() - samples_to_copy;
-    for (size_t i = 0; i < samples_to_copy; i++) {
-      buffer[i] = injected_audio_buffer_[start_index + i];
-    }
+  return std::min(samples_needed, injected_audio_buffer_.peek(samples));
+}
+
+void USBCommunicationComponent::get_latest_audio_data(std::vector<int16_t> &buffer, size_t samples_needed) {
+  buffer.resize(samples_needed);
+
+  size_t available = injected_audio_buffer_.available();
+  if (available > samples_needed) {
+    injected_audio_buffer_.consume(available - samples_needed);
   }
-  
-  ESP_LOGD(TAG, "Retrieved %zu audio samples from injection buffer", samples_to_copy);
+  size_t samples_copied = injected_audio_buffer_.read(buffer.data(), samples_needed);
+
+  // Pad with silence when not enough audio has been injected yet
+  std::fill(buffer.begin() + samples_copied, buffer.end(), 0);
+
+  ESP_LOGV(TAG, "Retrieved %zu audio samples from injection buffer", samples_copied);
 }
 
 }  // namespace usb_communication
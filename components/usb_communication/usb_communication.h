@@ -1,31 +1,74 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
+#include "esphome/core/ring_buffer.h"
 #include "esphome/components/speaker/speaker.h"
 #include "esphome/components/microphone/microphone.h"
 #include "esphome/components/i2s_audio/microphone/i2s_audio_microphone.h"
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+#include "esphome/components/voice_kit/voice_kit.h"
+#endif
+#include "audio_arena.h"
+#include "base64_decoder.h"
+#include "channel_selector.h"
+#include "clip_cache.h"
+#include "device_state.h"
+#include "i2s_convert.h"
+#include "ima_adpcm.h"
+#include "json_message.h"
+#include "resampler.h"
+#include "latency_trace.h"
+#include "link_benchmark.h"
+#include "message_channel.h"
+#include "preroll_buffer.h"
+#include "spsc_ring_buffer.h"
+#include "tone_synth.h"
+#include "tx_queue.h"
+#include "usb_frame.h"
+#include <atomic>
 #include <cstdio>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace esphome {
 namespace usb_communication {
 
+// Encoding of the audio carried by binary audio frames and audio_data_chunk messages, chosen per stream in
+// start_audio_stream
+enum AudioCodec : uint8_t {
+  AUDIO_CODEC_PCM_S16LE = 0,
+  AUDIO_CODEC_IMA_ADPCM = 1,
+};
+
+// What the microphone uplink carries, chosen per capture in start_capture
+enum UplinkMode : uint8_t {
+  UPLINK_MONO = 0,    // the configured mic_channel as FRAME_TYPE_MIC_AUDIO
+  UPLINK_STEREO = 1,  // both XMOS channels interleaved as FRAME_TYPE_MIC_AUDIO_STEREO
+  UPLINK_AUTO = 2,    // FRAME_TYPE_MIC_AUDIO from whichever channel ChannelSelector picks, flagged per frame
+};
+
 class USBCommunicationComponent : public Component {
  public:
   void setup() override;
   void loop() override;
   void dump_config() override;
+  // Ahead of voice_kit, whose can_proceed() holds back later components until the XMOS has booted, so the host can
+  // connect and get status while it does
+  float get_setup_priority() const override { return setup_priority::HARDWARE; }
   void mark_usb_activity();
-  
+
   // Getters for current configuration
-  std::string get_current_sensitivity() const { return current_sensitivity_; }
-  std::string get_current_wake_word() const { return current_wake_word_; }
-  int get_current_voice_phase() const { return current_voice_phase_; }
-  
+  std::string get_current_sensitivity() const { return state_.sensitivity; }
+  std::string get_current_wake_word() const { return state_.wake_word; }
+  int get_current_voice_phase() const { return state_.voice_phase; }
+  uint32_t get_rx_bytes_per_second() const { return rx_bytes_per_second_; }
+
   // Audio control getters
-  bool is_unmute_requested() { 
+  bool is_unmute_requested() {
     if (unmute_requested_) {
       unmute_requested_ = false;
       return true;
@@ -40,107 +83,472 @@ class USBCommunicationComponent : public Component {
     return false;
   }
   float get_requested_volume() const { return requested_volume_; }
-  
-  // Tone playback request getter
-  bool is_tone_playback_requested() {
-    if (tone_playback_requested_) {
-      tone_playback_requested_ = false;
-      return true;
-    }
-    return false;
+
+  // Tone playback request getter; only used when no speaker is set and play_tone falls back to a YAML sound
+  bool is_tone_playback_requested() { return tone_playback_requested_.exchange(false); }
+
+  // Setters for YAML to update current state; changes are pushed to the host as a status_delta from loop()
+  void update_voice_phase(int phase) { state_.set(STATE_VOICE_PHASE, state_.voice_phase, phase); }
+  void update_wake_word_active(bool active) { state_.set(STATE_WAKE_WORD_ACTIVE, state_.wake_word_active, active); }
+  void update_microphone_muted(bool muted) { state_.set(STATE_MICROPHONE_MUTED, state_.microphone_muted, muted); }
+  void update_volume(float volume) { state_.set(STATE_VOLUME, state_.volume, volume); }
+  void update_led_brightness(float brightness) {
+    state_.set(STATE_LED_BRIGHTNESS, state_.led_brightness, brightness);
   }
-  
-  // Setters for YAML to update current state
-  void update_voice_phase(int phase) { current_voice_phase_ = phase; }
-  
+  void update_timer_ringing(bool ringing) { state_.set(STATE_TIMER_RINGING, state_.timer_ringing, ringing); }
+
   // Audio playback trigger state
-  bool should_play_audio() { 
-    if (audio_trigger_pending_) {
-      audio_trigger_pending_ = false;
-      return true;
-    }
-    return false;
+  bool should_play_audio() { return audio_trigger_pending_.exchange(false); }
+
+  // Automation hooks (see automation.h), an alternative to polling the request getters above. They always run on
+  // the main loop: while the host message is handled, or on the next loop() for events raised on the pipeline task.
+  void add_on_volume_change_callback(std::function<void(float)> &&callback) {
+    this->volume_change_callback_.add(std::move(callback));
+  }
+  void add_on_unmute_callback(std::function<void()> &&callback) { this->unmute_callback_.add(std::move(callback)); }
+  // play_tone with no speaker to synthesize it on
+  void add_on_tone_callback(std::function<void(uint16_t, uint16_t)> &&callback) {
+    this->tone_callback_.add(std::move(callback));
+  }
+  void add_on_playback_complete_callback(std::function<void()> &&callback) {
+    this->playback_complete_callback_.add(std::move(callback));
+  }
+  // config messages that set the wake word or sensitivity; both arguments carry the current value
+  void add_on_config_callback(std::function<void(std::string, std::string)> &&callback) {
+    this->config_callback_.add(std::move(callback));
   }
-  
+
   // USB audio streaming methods (replicating voice assistant interface)
-  void set_speaker(speaker::Speaker *speaker) { 
-    target_speaker_ = speaker; 
+  void set_speaker(speaker::Speaker *speaker) {
+    target_speaker_ = speaker;
     ESP_LOGI("usb_communication", "Speaker reference set: %p", speaker);
   }
-  void set_microphone(microphone::Microphone *microphone) {
-    source_microphone_ = microphone;
-    ESP_LOGI("usb_communication", "Microphone reference set: %p", microphone);
+  void set_microphone(microphone::Microphone *microphone);
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  // Lets the host update the XMOS firmware over USB (xmos_update_begin followed by FRAME_TYPE_XMOS_FIRMWARE frames)
+  void set_voice_kit(voice_kit::VoiceKit *voice_kit) { voice_kit_ = voice_kit; }
+  // Replaces uplink frames with FRAME_TYPE_MIC_SILENCE markers once the XMOS VNR has been below threshold for
+  // hangover_ms
+  void set_vnr_gate(uint8_t threshold, uint32_t hangover_ms) {
+    vnr_gate_enabled_ = true;
+    vnr_gate_threshold_ = threshold;
+    vnr_gate_hangover_ms_ = hangover_ms;
   }
+#endif
   void start_audio_stream();
   void write_audio_chunk(const uint8_t *data, size_t length);
   void finish_audio_stream();
   bool has_audio_data() const { return usb_audio_buffer_size_ > 0; }
-  void clear_audio_buffer() { 
-    usb_audio_buffer_index_ = 0; 
-    usb_audio_buffer_size_ = 0; 
+  void clear_audio_buffer() {
+    usb_audio_buffer_index_ = 0;
+    usb_audio_buffer_read_index_ = 0;
+    usb_audio_buffer_size_ = 0;
+  }
+
+  // Playback starts once this much audio is buffered (or the stream finishes, whichever comes first)
+  void set_prebuffer_ms(uint32_t prebuffer_ms) { prebuffer_ms_ = prebuffer_ms; }
+  // Buffer sizes are fixed at setup(); the playback buffer must hold a whole number of samples
+  void set_playback_buffer_size(size_t size) { playback_buffer_size_ = size & ~size_t(1); }
+  // Room for clips uploaded with clip_upload_begin and replayed with play_clip; 0 disables the cache
+  void set_clip_cache_size(size_t size) { clip_cache_size_ = size; }
+  void set_mic_ring_ms(uint32_t mic_ring_ms) { mic_ring_ms_ = mic_ring_ms; }
+  void set_use_psram(bool use_psram) { use_psram_ = use_psram; }
+  // Longest JSON line accepted; longer lines are discarded whole and counted
+  void set_max_line_length(size_t length) { max_line_length_ = length; }
+  // Runs RX, playback feeding, the mic uplink and TX in a dedicated task instead of loop()
+  void set_task_config(uint8_t core, uint8_t priority, uint32_t stack_size) {
+    use_task_ = true;
+    task_core_ = core;
+    task_priority_ = priority;
+    task_stack_size_ = stack_size;
   }
-  
+
   // Microphone capture methods
+  // While the host uplink is running, captured audio is streamed as binary frames and capture_microphone_data()
+  // returns false; otherwise it pulls from the same capture buffer.
   bool capture_microphone_data(std::vector<int16_t> &buffer, size_t samples_needed);
   void start_microphone_capture();
   void stop_microphone_capture();
-  
+  bool is_uplink_active() const { return mic_uplink_active_; }
+  void set_mic_channel(MicChannel channel) { mic_channel_ = channel; }
+  // Uplink mode used when start_capture does not name one
+  void set_uplink_mode(UplinkMode mode) { uplink_mode_ = mode; }
+  // Length of the mono history kept while the microphone runs; 0 disables the pre-roll
+  void set_preroll_ms(uint32_t preroll_ms) { preroll_ms_ = preroll_ms; }
+  // Tells the host about the wake word, then starts the uplink in the default mode if a host is talking to us,
+  // opening with the pre-roll so the wake word and what follows it are not clipped. Call from on_wake_word_detected.
+  void on_wake_word_detected();
+  // Peak absolute sample value of the most recent microphone callback
+  uint16_t get_microphone_peak_level() const { return mic_peak_level_.load(std::memory_order_relaxed); }
+
   // Audio data injection (for receiving real microphone data)
+  // inject_audio_data() may only be called from a single producer (the microphone task); the readers below
+  // from the main loop.
   void inject_audio_data(const int16_t* samples, size_t sample_count);
+  // Converts raw 32-bit stereo I2S data from a microphone data callback with convert_i2s_stereo_to_mono() and injects it
+  void inject_microphone_data(const std::vector<uint8_t> &data);
   bool has_recent_audio_data() const;
   void get_latest_audio_data(std::vector<int16_t> &buffer, size_t samples_needed);
+  // Zero-copy access to the most recent injected audio: points at up to samples_needed samples in place (fewer if
+  // the ring wraps), release them with commit_audio_data()
+  size_t peek_latest_audio_data(const int16_t **samples, size_t samples_needed);
+  void commit_audio_data(size_t sample_count) { injected_audio_buffer_.consume(sample_count); }
+  uint32_t get_injected_audio_dropped() const { return injected_audio_buffer_.dropped(); }
 
  protected:
-  bool read_line_(std::string *line);
-  void process_message_(const std::string &message);
-  void process_config_(const std::string &message);
-  void process_play_audio_(const std::string &message);
-  void process_play_audio_compressed_(const std::string &message);
-  void process_play_tone_(const std::string &message);
-  void process_play_audio_chunk_(const std::string &message);
-  void process_audio_data_chunk_(const std::string &message);
+  void fill_rx_ring_();
+  void run_pipeline_();
+  static void pipeline_task_(void *param);
+  bool on_pipeline_task_() const;
+  void run_on_main_loop_(uint8_t command);
+  void run_main_loop_command_(uint8_t command);
+  bool read_line_(std::string_view *line);
+  bool handle_frame_byte_(uint8_t byte);
+  void process_frame_(const FrameHeader &header, const uint8_t *payload);
+  // Control message dispatch: every handler gets the already tokenized message
+  struct MessageHandler {
+    std::string_view type;
+    void (USBCommunicationComponent::*handler)(const JsonMessage &message);
+    bool main_loop;  // touches ESPHome components or YAML-visible state, so never runs on the pipeline task
+    bool needs_audio;  // uses the speaker or microphone, which wait for the XMOS to boot
+  };
+  static const MessageHandler *find_message_handler_(std::string_view type);
+  void process_message_(std::string_view message);
+  bool audio_ready_();
+  void process_heartbeat_(const JsonMessage &message);
+  void process_get_status_(const JsonMessage &message);
+  void process_get_wake_word_options_(const JsonMessage &message);
+  void process_disconnect_(const JsonMessage &message);
+  void process_start_capture_(const JsonMessage &message);
+  void process_stop_capture_(const JsonMessage &message);
+  void process_benchmark_(const JsonMessage &message);
+  void process_benchmark_mic_convert_(const JsonMessage &message);
+  void run_benchmark_();
+  void send_benchmark_ping_();
+  void send_benchmark_report_(bool completed);
+  void process_finish_audio_stream_(const JsonMessage &message);
+  void process_config_(const JsonMessage &message);
+  void process_play_audio_(const JsonMessage &message);
+  void process_play_audio_compressed_(const JsonMessage &message);
+  void process_play_tone_(const JsonMessage &message);
+  void process_play_audio_chunk_(const JsonMessage &message);
+  void process_audio_data_chunk_(const JsonMessage &message);
+  void process_start_audio_stream_(const JsonMessage &message);
+  void process_xmos_update_begin_(const JsonMessage &message);
+  void process_clip_upload_begin_(const JsonMessage &message);
+  void process_has_clip_(const JsonMessage &message);
+  void process_play_clip_(const JsonMessage &message);
+  void receive_clip_data_(const FrameHeader &header, const uint8_t *payload);
+  void pump_clip_();
+  void send_clip_error_(std::string_view id, const char *reason);
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  void service_xmos_update_();
+  void send_xmos_update_credit_(const char *response_type);
+  bool vnr_gate_closed_() const;
+  void on_voice_kit_state_(voice_kit::DFUAutomationState state, float progress,
+                           voice_kit::VoiceKitUpdaterStatus status);
+#endif
+  size_t write_decimal_samples_(std::string_view array);
+  uint32_t speaker_sample_rate_() const;
+  // write_audio_chunk() once the data is whole samples: resamples if needed, then buffers
+  void write_audio_samples_(const uint8_t *data, size_t length);
+  void write_playback_buffer_(const uint8_t *data, size_t length);
+  void commit_audio_(size_t length);
+  void begin_audio_segment_(uint32_t sequence);
+  void report_audio_drop_(size_t length);
+  uint32_t credit_limit_() const;
+  void send_credit_();
+  void send_credit_response_(const char *response_type);
+  void send_chunk_dropped_(uint32_t chunk_index, const char *reason);
+#ifdef USE_USB_COMMUNICATION_TRACE
+  void process_get_trace_(const JsonMessage &message);
+  void process_get_latency_stats_(const JsonMessage &message);
+#endif
+  void write_encoded_audio_(const uint8_t *data, size_t length);
+  void on_microphone_data_(const std::vector<uint8_t> &data);
+  void send_microphone_frames_();
+  void send_frame_(uint8_t type, const uint8_t *payload, uint16_t length, uint8_t flags = 0);
+  bool start_uplink_(UplinkMode mode, const char *trigger);
+  void send_capture_started_(const char *trigger);
+  void refresh_mic_stages_();
+  bool uplink_voice_() const;
+  void begin_playback_();
+  void feed_speaker_();
+  void stage_speaker_block_();
+  size_t play_speaker_(const uint8_t *data, size_t length);
+  void drain_speaker_feed_();
   void send_status_update_();
+  void send_status_delta_();
   void send_wake_word_options_();
   void send_response_(const char* response_type);
   void send_json_(const std::string &json);
-  
+  void send_frame_error_(const char *reason, uint16_t sequence);
+  void send_line_overflow_();
+
  private:
-  std::string input_buffer_;
-  std::string current_wake_word_ = "Okay Nabu";
-  std::string current_sensitivity_ = "Moderately sensitive";
-  int current_voice_phase_ = 1;  // Default to idle phase
-  bool audio_trigger_pending_ = false;
-  
+  // JSON lines are assembled in one preallocated arena buffer and dispatched in place
+  size_t max_line_length_{16 * 1024};
+  char *line_buffer_{nullptr};
+  size_t line_length_{0};
+  bool line_discarding_{false};  // the current line overflowed; skip to its newline
+  uint32_t rx_line_overflows_{0};
+
+  // Bulk RX ring, filled straight from the USB Serial/JTAG driver (bypassing stdio line ending translation)
+  static const size_t RX_RING_SIZE = 8 * 1024;  // must be a power of two
+  uint8_t rx_ring_[RX_RING_SIZE];
+  size_t rx_ring_head_{0};  // total bytes written, masked on access
+  size_t rx_ring_tail_{0};  // total bytes consumed, masked on access
+
+  // Inbound throughput accounting
+  uint32_t rx_bytes_total_{0};
+  uint32_t rx_bytes_window_{0};
+  uint32_t rx_window_start_{0};
+  uint32_t rx_bytes_per_second_{0};
+
+  // Binary frame reception (audio payloads bypass JSON entirely)
+  FrameParser frame_parser_;
+  uint32_t last_frame_byte_time_{0};
+  uint16_t rx_frame_sequence_{0};
+  uint32_t rx_frame_count_{0};
+  uint32_t rx_frames_lost_{0};
+  uint32_t rx_frame_errors_{0};
+  static const uint32_t FRAME_BYTE_TIMEOUT_MS = 500;
+  DeviceState state_;
+  uint32_t last_message_time_{0};
+  std::atomic<bool> audio_trigger_pending_{false};
+
   // Audio control flags
   bool unmute_requested_ = false;
   bool volume_change_requested_ = false;
   float requested_volume_ = 0.85;
-  bool tone_playback_requested_ = false;
-  
-  // Audio chunk management
-  std::vector<std::vector<int>> audio_chunks_;
-  int expected_total_chunks_ = 0;
-  int received_chunks_ = 0;
-  
+  std::atomic<bool> tone_playback_requested_{false};
+  void request_volume_(float volume);
+  void request_unmute_();
+  void dispatch_events_();
+  CallbackManager<void(float)> volume_change_callback_;
+  CallbackManager<void()> unmute_callback_;
+  CallbackManager<void(uint16_t, uint16_t)> tone_callback_;
+  CallbackManager<void()> playback_complete_callback_;
+  CallbackManager<void(std::string, std::string)> config_callback_;
+  // Raised wherever the event happens, delivered to the callbacks from loop()
+  std::atomic<bool> tone_event_pending_{false};
+  uint16_t tone_event_frequency_{0};
+  uint16_t tone_event_duration_ms_{0};
+  std::atomic<bool> playback_complete_event_pending_{false};
+
+  // Compressed (base64) playback; a clip may be split across several messages with "final":false
+  Base64Decoder base64_decoder_;
+  bool compressed_stream_active_{false};
+  size_t compressed_bytes_decoded_{0};
+  long compressed_expected_samples_{0};
+  static const size_t BASE64_DECODE_BLOCK_SIZE = 192;
+
+  // Scratch space for decimal audio_data_chunk payloads, FRAME_MAX_PAYLOAD bytes from the arena
+  uint8_t *chunk_bytes_{nullptr};
+
+  // Downlink flow control. The host may have sent at most credit_limit_() decoded bytes since the stream started;
+  // the limit is cumulative, so a lost or late credit message never lets the host overrun the buffer.
+  static const uint32_t CREDIT_INTERVAL_MS = 50;
+  static const size_t CREDIT_MIN_GRANT = 2048;
+  uint32_t stream_bytes_accepted_{0};
+  uint32_t credit_sent_limit_{0};
+  uint32_t last_credit_time_{0};
+  // Sequence of the frame or message currently being written, reported with any audio it loses
+  uint32_t audio_sequence_{0};
+  bool audio_sequence_dropped_{false};
+  uint32_t audio_bytes_dropped_{0};
+
+  // play_audio_chunk reassembly. Every chunk but the last has the same size, so chunk N lands at a fixed offset
+  // from the end of the contiguous prefix and is written straight into the playback ring. Bit i of chunk_bitmap_
+  // marks chunk chunk_next_ + i as present; the prefix is committed (and becomes playable) as soon as it is complete.
+  static const uint32_t CHUNK_WINDOW = 64;
+  uint64_t chunk_bitmap_{0};
+  uint32_t chunk_next_{0};
+  uint32_t chunk_total_{0};
+  size_t chunk_stride_bytes_{0};
+  size_t chunk_last_bytes_{0};
+  uint32_t chunks_dropped_{0};
+
   // USB Audio streaming buffer (replicating voice assistant architecture)
-  static const size_t USB_AUDIO_BUFFER_SIZE = 16 * 1024; // 16KB like voice assistant
+  // Used as a ring: the host writes at usb_audio_buffer_index_ while loop() feeds the speaker from
+  // usb_audio_buffer_read_index_, so clips can be longer than the buffer.
+  size_t playback_buffer_size_{16 * 1024};  // 16KB like voice assistant
   uint8_t *usb_audio_buffer_;
   size_t usb_audio_buffer_index_;
+  size_t usb_audio_buffer_read_index_{0};
   size_t usb_audio_buffer_size_;
   bool is_streaming_audio_;
-  
+  // Odd trailing byte of the last audio chunk, waiting for the rest of its sample
+  uint8_t audio_carry_byte_{0};
+  bool audio_carry_pending_{false};
+  AudioCodec stream_codec_{AUDIO_CODEC_PCM_S16LE};
+  ImaAdpcmDecoder adpcm_decoder_;
+
+  // Streams may declare a sample_rate; audio is resampled to the speaker's native rate before buffering
+  Resampler resampler_;
+  bool resampling_{false};
+  uint32_t stream_sample_rate_{16000};
+  uint32_t output_sample_rate_{16000};
+  static const size_t RESAMPLE_BLOCK_SAMPLES = 128;
+  static const size_t RESAMPLE_OUTPUT_SAMPLES = 256;
+  static_assert(RESAMPLE_OUTPUT_SAMPLES >= Resampler::MAX_OUTPUTS_PER_INPUT,
+                "the resampler needs room for every output of one input sample");
+  static const size_t ADPCM_DECODE_BLOCK_BYTES = 128;  // decoded 256 samples at a time
+
+  // Incremental playback state
+  enum PlaybackState : uint8_t {
+    PLAYBACK_IDLE,
+    PLAYBACK_BUFFERING,  // stream open, waiting for the prebuffer threshold
+    PLAYBACK_PLAYING,    // speaker is being topped up from loop()
+    PLAYBACK_DRAINING,   // stream finished, playing out what is left
+  };
+  PlaybackState playback_state_{PLAYBACK_IDLE};
+  uint32_t prebuffer_ms_{30};
+  static const size_t SPEAKER_WRITE_CHUNK_SIZE = 1024;
+
+  // Tone engine (play_tone). Tones are rendered a block at a time straight into the speaker feed and mixed over any
+  // stream that is playing, so the first samples go out as soon as the message is handled.
+  static const size_t TONE_BLOCK_SAMPLES = 256;
+  ToneSynth tone_;
+  bool tone_playing_{false};
+  int16_t tone_block_[TONE_BLOCK_SAMPLES];
+  size_t tone_block_bytes_{0};
+  size_t tone_block_offset_{0};
+
   // Speaker reference for direct streaming
   speaker::Speaker *target_speaker_;
-  
+
   // Microphone reference for audio capture
-  microphone::Microphone *source_microphone_;
-  bool is_capturing_audio_;
-  std::vector<int16_t> microphone_buffer_;
-  
+  microphone::Microphone *source_microphone_{nullptr};
+  std::atomic<bool> is_capturing_audio_{false};
+
+  // Microphone uplink: the mic task converts I2S frames into mic_ring_buffer_, loop() sends them as binary frames
+  uint32_t mic_ring_ms_{200};
+  static const size_t MIC_FRAME_SAMPLES = 320;                               // 20ms per uplink frame
+  static const size_t MIC_CONVERT_BLOCK_SAMPLES = 256;
+  MicChannel mic_channel_{MIC_CHANNEL_LEFT};
+  // uplink_mode_ is the configured default; capture_mode_ is what the mic task converts for the running capture
+  UplinkMode uplink_mode_{UPLINK_MONO};
+  std::atomic<uint8_t> capture_mode_{UPLINK_MONO};
+  ChannelSelector channel_selector_;
+  // Pre-roll: filled and flushed on the mic task; the flush is requested by start_uplink_()
+  static const uint32_t PREROLL_GAP_MS = 250;
+  static const uint32_t HOST_IDLE_MS = 10000;
+  uint32_t preroll_ms_{500};
+  PrerollBuffer preroll_;
+  uint32_t preroll_last_write_ms_{0};
+  std::atomic<bool> preroll_flush_pending_{false};
+  // XMOS pipeline stage of each channel, refreshed from the main loop for the stereo frame header
+  std::atomic<uint8_t> mic_stages_[2]{{MIC_STAGE_UNKNOWN}, {MIC_STAGE_UNKNOWN}};
+  std::atomic<uint16_t> mic_peak_level_{0};
+  std::unique_ptr<RingBuffer> mic_ring_buffer_;
+  bool mic_callback_registered_{false};
+  bool mic_started_by_capture_{false};
+  std::atomic<bool> mic_uplink_active_{false};
+  // Moved back by the pre-roll length when the mic task flushes it
+  std::atomic<uint32_t> mic_capture_start_ms_{0};
+  uint32_t mic_sample_index_{0};
+  uint32_t mic_frames_sent_{0};
+  uint16_t tx_frame_sequence_{0};
+
+#ifdef USE_USB_COMMUNICATION_TRACE
+  // Per-stage latency tracing, queried with get_trace / get_latency_stats
+  LatencyTrace trace_;
+  uint32_t trace_rx_read_us_{0};
+  uint32_t trace_stream_start_us_{0};
+  uint32_t trace_stream_finish_us_{0};
+  bool trace_first_play_pending_{false};
+  std::atomic<uint32_t> trace_mic_callback_us_{0};
+#endif
+
+  // Outbound messages, drained from loop() straight into the driver
+  static const size_t TX_CONTROL_LANE_SIZE = 8 * 1024;
+  static const size_t TX_BULK_LANE_SIZE = 4 * 1024;
+  static const size_t TX_DRIVER_BUFFER_SIZE = 8 * 1024;  // must hold the largest single message
+  TxQueue tx_queue_;
+
+  // Link benchmark. Driven from the pipeline like the traffic it measures; source frames share the bulk lane with
+  // the mic uplink, which waits while a source run keeps it full.
+  static const size_t BENCH_SOURCE_FRAME_MAX = TX_BULK_LANE_SIZE / 2 - FRAME_HEADER_SIZE;
+  static const size_t BENCH_PING_SIZE_MAX = 1024;
+  static const uint32_t BENCH_PING_TIMEOUT_MS = 1000;
+  LinkBenchmark benchmark_;
+  size_t bench_frame_size_{0};
+  uint32_t bench_interval_ms_{0};
+  uint32_t bench_ping_id_{0};
+  uint32_t bench_ping_sent_us_{0};
+  uint32_t bench_ping_sent_ms_{0};
+  bool bench_ping_outstanding_{false};
+  uint32_t bench_start_frames_lost_{0};
+  uint32_t bench_start_frame_errors_{0};
+
+  // Optional pipeline task. It owns the USB port, the playback buffer and the mic uplink; main-loop-only work is
+  // handed over through lock-free channels (control messages and speaker commands one way, responses the other).
+  enum MainLoopCommand : uint8_t {
+    COMMAND_SPEAKER_START,
+    COMMAND_SPEAKER_FINISH,
+  };
+  static const size_t TASK_CHANNEL_SIZE = 4096;
+  static const size_t TASK_MESSAGE_MAX = 2048;
+  static const size_t TASK_COMMAND_QUEUE_SIZE = 16;
+  bool use_task_{false};
+  uint8_t task_core_{1};
+  uint8_t task_priority_{10};
+  uint32_t task_stack_size_{8192};
+  TaskHandle_t pipeline_task_handle_{nullptr};
+  MessageChannel to_main_loop_;
+  MessageChannel from_main_loop_;
+  uint8_t *task_message_buffer_{nullptr};       // pipeline side
+  uint8_t *main_loop_message_buffer_{nullptr};  // main loop side
+  uint8_t main_loop_command_storage_[TASK_COMMAND_QUEUE_SIZE];
+  SPSCRingBuffer<uint8_t> main_loop_commands_;
+  // ESPHome speakers are driven from the main loop only: the task stages speaker audio here and loop() hands it to
+  // play(). A finish command waits until the feed is empty, so the speaker never finishes ahead of queued audio.
+  static const size_t SPEAKER_FEED_SIZE = 4096;
+  SPSCRingBuffer<uint8_t> speaker_feed_;
+  bool speaker_finish_pending_{false};
+
+  // Playback buffer, TX lanes and scratch space; PSRAM unless disabled or unavailable
+  AudioArena audio_arena_;
+  bool use_psram_{true};
+
+  // Clip cache. A playing clip is streamed into the playback buffer as it frees up, so it goes through the same
+  // resampling, tone mixing and completion path as a host stream.
+  static const size_t CLIP_PUMP_BYTES = 512;
+  size_t clip_cache_size_{0};
+  ClipCache clip_cache_;
+  int clip_play_slot_{ClipCache::NO_CLIP};
+  size_t clip_play_offset_{0};
+
   // Audio data injection for real microphone data
-  std::vector<int16_t> injected_audio_buffer_;
-  unsigned long last_audio_injection_time_;
-  static const size_t MAX_INJECTED_AUDIO_BUFFER_SIZE = 1600; // 100ms at 16kHz
+  static const size_t MAX_INJECTED_AUDIO_BUFFER_SIZE = 2048; // ~128ms at 16kHz, power of two for the ring
+  int16_t injected_audio_storage_[MAX_INJECTED_AUDIO_BUFFER_SIZE];
+  SPSCRingBuffer<int16_t> injected_audio_buffer_;
+  std::atomic<uint32_t> last_audio_injection_time_{0};
+
+#ifdef USE_USB_COMMUNICATION_VOICE_KIT
+  // Host-streamed XMOS firmware. The RX path queues image frames here and loop() hands them to VoiceKit as fast as
+  // its DFU state machine takes them; the host's cumulative credit is what loop() has handed over plus the ring size,
+  // so I2C sets the pace.
+  static const size_t XMOS_UPDATE_RING_SIZE = 4096;  // must be a power of two
+  voice_kit::VoiceKit *voice_kit_{nullptr};
+  SPSCRingBuffer<uint8_t> xmos_update_ring_;
+  std::atomic<bool> xmos_update_active_{false};
+  uint32_t xmos_update_length_{0};
+  uint32_t xmos_update_forwarded_{0};
+  uint32_t xmos_update_dropped_base_{0};
+  uint32_t xmos_credit_sent_limit_{0};
+  uint32_t xmos_last_credit_time_{0};
+
+  // VNR gate. The flags are set from VoiceKit's callback on the main loop and read by the uplink
+  static const uint32_t VNR_GATE_POLL_INTERVAL_MS = 50;
+  bool vnr_gate_enabled_{false};
+  uint8_t vnr_gate_threshold_{0};
+  uint32_t vnr_gate_hangover_ms_{0};
+  std::atomic<bool> vnr_voice_{true};
+  std::atomic<uint32_t> vnr_quiet_since_ms_{0};
+  uint32_t mic_frames_suppressed_{0};
+#endif
 };
 
 }  // namespace usb_communication
@@ -0,0 +1,91 @@
+#include "usb_frame.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace usb_communication {
+
+namespace {
+
+struct Crc16Table {
+  uint16_t entries[256];
+  constexpr Crc16Table() : entries() {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = i << 8;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+      }
+      this->entries[i] = crc;
+    }
+  }
+};
+
+constexpr Crc16Table CRC16_TABLE{};
+
+}  // namespace
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t length, uint16_t crc) {
+  for (size_t i = 0; i < length; i++) {
+    crc = (crc << 8) ^ CRC16_TABLE.entries[((crc >> 8) ^ data[i]) & 0xFF];
+  }
+  return crc;
+}
+
+void encode_frame_header(uint8_t *out, uint8_t type, uint8_t flags, uint16_t sequence, const uint8_t *payload,
+                         uint16_t length) {
+  out[0] = FRAME_MAGIC_0;
+  out[1] = FRAME_MAGIC_1;
+  out[2] = type;
+  out[3] = flags;
+  out[4] = sequence & 0xFF;
+  out[5] = sequence >> 8;
+  out[6] = length & 0xFF;
+  out[7] = length >> 8;
+  uint16_t crc = crc16_ccitt(&out[2], 6);
+  crc = crc16_ccitt(payload, length, crc);
+  out[8] = crc & 0xFF;
+  out[9] = crc >> 8;
+}
+
+FrameParser::Result FrameParser::push(uint8_t byte) {
+  if (this->position_ < FRAME_HEADER_SIZE) {
+    if ((this->position_ == 0 && byte != FRAME_MAGIC_0) || (this->position_ == 1 && byte != FRAME_MAGIC_1)) {
+      this->position_ = 0;
+      return FRAME_BAD_MAGIC;
+    }
+    this->header_bytes_[this->position_++] = byte;
+    if (this->position_ < FRAME_HEADER_SIZE) {
+      return NEED_MORE;
+    }
+
+    this->header_.type = this->header_bytes_[2];
+    this->header_.flags = this->header_bytes_[3];
+    this->header_.sequence = this->header_bytes_[4] | (this->header_bytes_[5] << 8);
+    this->header_.length = this->header_bytes_[6] | (this->header_bytes_[7] << 8);
+    this->header_.crc = this->header_bytes_[8] | (this->header_bytes_[9] << 8);
+    if (this->header_.length > FRAME_MAX_PAYLOAD) {
+      this->position_ = 0;
+      return FRAME_BAD_LENGTH;
+    }
+    if (this->header_.length > 0) {
+      return NEED_MORE;
+    }
+  } else {
+    this->payload_[this->position_++ - FRAME_HEADER_SIZE] = byte;
+    if (this->position_ < FRAME_HEADER_SIZE + this->header_.length) {
+      return NEED_MORE;
+    }
+  }
+
+  // Header and payload complete
+  this->position_ = 0;
+  uint16_t crc = crc16_ccitt(&this->header_bytes_[2], 6);
+  crc = crc16_ccitt(this->payload_, this->header_.length, crc);
+  if (crc != this->header_.crc) {
+    return FRAME_BAD_CRC;
+  }
+  return FRAME_READY;
+}
+
+}  // namespace usb_communication
+}  // namespace esphome
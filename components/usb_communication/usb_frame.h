@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace usb_communication {
+
+// Binary frames share the USB Serial/JTAG stream with the newline-terminated JSON control messages. A JSON message
+// always starts with '{', so the first magic byte (which is not valid ASCII) is enough for the RX path to tell them
+// apart.
+//
+// Wire layout, all multi-byte fields little-endian:
+//   [0]     magic 0xA5
+//   [1]     magic 0x5A
+//   [2]     frame type (FrameType)
+//   [3]     flags, per frame type (0 unless noted)
+//   [4..5]  sequence number, incremented per frame and per direction
+//   [6..7]  payload length in bytes
+//   [8..9]  CRC-16/CCITT-FALSE over bytes [2..8) followed by the payload
+//   [10..]  payload
+static const uint8_t FRAME_MAGIC_0 = 0xA5;
+static const uint8_t FRAME_MAGIC_1 = 0x5A;
+static const size_t FRAME_HEADER_SIZE = 10;
+static const size_t FRAME_MAX_PAYLOAD = 4096;
+
+enum FrameType : uint8_t {
+  FRAME_TYPE_AUDIO_DATA = 0x01,  // host -> device: audio for the active playback stream, in the stream's codec
+  FRAME_TYPE_XMOS_FIRMWARE = 0x02,  // host -> device: next bytes of the image announced by xmos_update_begin
+  FRAME_TYPE_CLIP_DATA = 0x03,  // host -> device: uint32 byte offset, then the next bytes of the clip being uploaded
+  FRAME_TYPE_MIC_AUDIO = 0x10,   // device -> host: MicFrameHeader followed by int16 mono PCM
+  FRAME_TYPE_MIC_SILENCE = 0x11,  // device -> host: MicFrameHeader and a uint16 count of samples the VNR gate held back
+  FRAME_TYPE_MIC_AUDIO_STEREO = 0x12,  // device -> host: MicStereoFrameHeader followed by interleaved int16 stereo
+  // Link benchmark (see LinkBenchmark)
+  FRAME_TYPE_BENCH_ECHO = 0x20,    // both ways: the device returns host echo frames with the payload unchanged
+  FRAME_TYPE_BENCH_SINK = 0x21,    // host -> device: counted and discarded
+  FRAME_TYPE_BENCH_SOURCE = 0x22,  // device -> host: generated data
+  FRAME_TYPE_BENCH_PING = 0x23,    // device -> host, returned unchanged: uint32 id, uint32 device micros(), padding
+};
+
+// Prefix of every FRAME_TYPE_MIC_AUDIO payload. sample_index counts samples since capture started, so the host can
+// detect gaps; timestamp_ms is the device millis() at which the first sample of the frame was captured.
+static const size_t MIC_FRAME_HEADER_SIZE = 8;
+struct MicFrameHeader {
+  uint32_t sample_index;
+  uint32_t timestamp_ms;
+};
+
+// FRAME_TYPE_MIC_AUDIO flag: the samples come from XMOS channel 1 rather than channel 0 (auto uplink mode)
+static const uint8_t MIC_FRAME_FLAG_CHANNEL_1 = 0x01;
+
+// Prefix of every FRAME_TYPE_MIC_AUDIO_STEREO payload. stage holds the XMOS pipeline stage applied to channel 0 and
+// channel 1 (voice_kit PipelineStages), or MIC_STAGE_UNKNOWN without a configured VoiceKit. sample_index counts
+// stereo frames, and silence markers sent in stereo mode count frames as well.
+static const size_t MIC_STEREO_FRAME_HEADER_SIZE = 12;
+static const uint8_t MIC_STAGE_UNKNOWN = 0xFF;
+struct MicStereoFrameHeader {
+  uint32_t sample_index;
+  uint32_t timestamp_ms;
+  uint8_t stage[2];
+  uint16_t reserved;
+};
+
+// Prefix of every FRAME_TYPE_CLIP_DATA payload: where the bytes go in the clip announced by clip_upload_begin. A
+// frame that does not continue exactly where the previous one ended aborts the upload.
+static const size_t CLIP_FRAME_HEADER_SIZE = 4;
+
+struct FrameHeader {
+  uint8_t type;
+  uint8_t flags;
+  uint16_t sequence;
+  uint16_t length;
+  uint16_t crc;
+};
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+// Writes a complete FRAME_HEADER_SIZE byte header for the given payload into out
+void encode_frame_header(uint8_t *out, uint8_t type, uint8_t flags, uint16_t sequence, const uint8_t *payload,
+                         uint16_t length);
+
+// Incremental parser for a single binary frame. Bytes are pushed as they arrive; the header and payload stay valid
+// after FRAME_READY until the next push() or reset().
+class FrameParser {
+ public:
+  enum Result : uint8_t {
+    NEED_MORE,
+    FRAME_READY,
+    FRAME_BAD_MAGIC,
+    FRAME_BAD_LENGTH,
+    FRAME_BAD_CRC,
+  };
+
+  Result push(uint8_t byte);
+  void reset() { this->position_ = 0; }
+  bool in_progress() const { return this->position_ > 0; }
+
+  const FrameHeader &header() const { return this->header_; }
+  const uint8_t *payload() const { return this->payload_; }
+
+ protected:
+  uint8_t header_bytes_[FRAME_HEADER_SIZE];
+  uint8_t payload_[FRAME_MAX_PAYLOAD];
+  FrameHeader header_{};
+  size_t position_{0};
+};
+
+}  // namespace usb_communication
+}  // namespace esphome
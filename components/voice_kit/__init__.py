@@ -40,8 +40,11 @@ PIPELINE_STAGES = {
     "AGC": PipelineStages.PIPELINE_STAGE_AGC,
 }
 
+CONF_BOOT_TIMEOUT = "boot_timeout"
 CONF_CHANNEL_0_STAGE = "channel_0_stage"
 CONF_CHANNEL_1_STAGE = "channel_1_stage"
+CONF_VNR_POLL_INTERVAL = "vnr_poll_interval"
+CONF_VNR_THRESHOLD = "vnr_threshold"
 
 DFUEndTrigger = voice_kit_ns.class_("DFUEndTrigger", automation.Trigger.template())
 DFUErrorTrigger = voice_kit_ns.class_("DFUErrorTrigger", automation.Trigger.template())
@@ -82,6 +85,13 @@ CONFIG_SCHEMA = (
         {
             cv.GenerateID(): cv.declare_id(VoiceKit),
             cv.Required(CONF_RESET_PIN): pins.gpio_output_pin_schema,
+            # Deadline for the XMOS to answer after reset; it is probed repeatedly until then
+            cv.Optional(CONF_BOOT_TIMEOUT, default="10s"): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(
+                    min=cv.TimePeriod(milliseconds=500), max=cv.TimePeriod(seconds=60)
+                ),
+            ),
             cv.GenerateID(CONF_RAW_DATA_ID): cv.declare_id(cg.uint8),
             cv.Optional(CONF_CHANNEL_0_STAGE, default="AGC"): cv.enum(
                 PIPELINE_STAGES, upper=True
@@ -89,6 +99,12 @@ CONFIG_SCHEMA = (
             cv.Optional(CONF_CHANNEL_1_STAGE, default="NS"): cv.enum(
                 PIPELINE_STAGES, upper=True
             ),
+            # Background polling of VNR and pipeline stages; disabled unless set
+            cv.Optional(CONF_VNR_POLL_INTERVAL): cv.All(
+                cv.positive_time_period_milliseconds,
+                cv.Range(min=cv.TimePeriod(milliseconds=10)),
+            ),
+            cv.Optional(CONF_VNR_THRESHOLD, default=0): cv.int_range(min=0, max=100),
             cv.Optional(CONF_FIRMWARE): cv.All(
                 {
                     cv.Required(CONF_URL): cv.url,
@@ -158,9 +174,13 @@ async def to_code(config):
 
     pin = await cg.gpio_pin_expression(config[CONF_RESET_PIN])
     cg.add(var.set_reset_pin(pin))
+    cg.add(var.set_boot_timeout(config[CONF_BOOT_TIMEOUT]))
 
     cg.add(var.set_channel_0_stage(config[CONF_CHANNEL_0_STAGE]))
     cg.add(var.set_channel_1_stage(config[CONF_CHANNEL_1_STAGE]))
+    if poll_interval := config.get(CONF_VNR_POLL_INTERVAL):
+        cg.add(var.set_register_poll_interval(poll_interval))
+    cg.add(var.set_vnr_threshold(config[CONF_VNR_THRESHOLD]))
 
     if config_fw := config.get(CONF_FIRMWARE):
         firmware_version = config_fw[CONF_VERSION].split(".")
@@ -192,7 +212,9 @@ async def to_code(config):
             use_state_callback = True
         for conf in config_fw.get(CONF_ON_PROGRESS, []):
             trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
-            await automation.build_automation(trigger, [(float, "x")], conf)
+            await automation.build_automation(
+                trigger, [(float, "x"), (float, "kbps")], conf
+            )
             use_state_callback = True
         for conf in config_fw.get(CONF_ON_END, []):
             trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
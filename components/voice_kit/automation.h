@@ -27,13 +27,13 @@ class DFUStartTrigger : public Trigger<> {
   }
 };
 
-class DFUProgressTrigger : public Trigger<float> {
+class DFUProgressTrigger : public Trigger<float, float> {
  public:
   explicit DFUProgressTrigger(VoiceKit *parent) {
     parent->add_on_state_callback(
         [this, parent](DFUAutomationState state, float progress, VoiceKitUpdaterStatus error) {
           if (state == DFU_IN_PROGRESS && !parent->is_failed()) {
-            trigger(progress);
+            trigger(progress, parent->get_dfu_transfer_rate());
           }
         });
   }
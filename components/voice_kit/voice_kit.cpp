@@ -5,13 +5,28 @@
 #include "esphome/core/defines.h"
 #include "esphome/core/log.h"
 
+#include <algorithm>
 #include <cinttypes>
+#include <cstring>
 
 namespace esphome {
 namespace voice_kit {
 
 static const char *const TAG = "voice_kit";
 
+// CRC-32 (IEEE 802.3, reflected) without the final inversion, a nibble at a time to keep the table small
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t length) {
+  static const uint32_t TABLE[16] = {0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+                                     0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+                                     0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ TABLE[crc & 0x0F];
+  }
+  return crc;
+}
+
 void VoiceKit::setup() {
   ESP_LOGCONFIG(TAG, "Setting up Voice Kit...");
 
@@ -20,26 +35,56 @@ void VoiceKit::setup() {
   this->reset_pin_->digital_write(true);
   delay(1);
   this->reset_pin_->digital_write(false);
-  // Wait for XMOS to boot...
-  this->set_timeout(3000, [this]() {
-    if (!this->dfu_get_version_()) {
-      ESP_LOGE(TAG, "Communication with Voice Kit failed");
-      this->mark_failed();
-    } else if (!this->versions_match_() && this->firmware_bin_is_valid_()) {
-      ESP_LOGW(TAG, "Expected XMOS version: %u.%u.%u; found: %u.%u.%u. Updating...", this->firmware_bin_version_major_,
-               this->firmware_bin_version_minor_, this->firmware_bin_version_patch_, this->firmware_version_major_,
-               this->firmware_version_minor_, this->firmware_version_patch_);
-      this->start_dfu_update();
-    } else {
-      this->write_pipeline_stages();
-    }
-  });
+  // Probe for the XMOS instead of waiting out its worst-case boot time: can_proceed() holds back the components
+  // set up after this one until it answers
+  this->boot_start_ms_ = millis();
+  this->boot_probe_interval_ms_ = BOOT_PROBE_FIRST_INTERVAL_MS;
+  this->boot_probes_ = 0;
+  this->set_timeout("boot_probe", BOOT_PROBE_FIRST_DELAY_MS, [this]() { this->probe_boot_(); });
+}
+
+void VoiceKit::probe_boot_() {
+  this->boot_probes_++;
+  // Failed probes are expected until the XMOS control server is up, so they are not worth a warning
+  if (this->dfu_get_version_(true)) {
+    ESP_LOGI(TAG, "XMOS ready after %" PRIu32 " ms (%" PRIu32 " probes)", millis() - this->boot_start_ms_,
+             this->boot_probes_);
+    this->finish_boot_();
+    return;
+  }
+
+  uint32_t elapsed = millis() - this->boot_start_ms_;
+  if (elapsed >= this->boot_timeout_ms_) {
+    ESP_LOGE(TAG, "Communication with Voice Kit failed: no answer after %" PRIu32 " ms", elapsed);
+    this->mark_failed();
+    return;
+  }
+  // Back off so a slow boot does not keep the bus busy, but always probe once more right at the deadline
+  uint32_t wait = std::min(this->boot_probe_interval_ms_, this->boot_timeout_ms_ - elapsed);
+  this->boot_probe_interval_ms_ = std::min(this->boot_probe_interval_ms_ * 2, BOOT_PROBE_MAX_INTERVAL_MS);
+  this->set_timeout("boot_probe", wait, [this]() { this->probe_boot_(); });
+}
+
+void VoiceKit::finish_boot_() {
+  if (!this->versions_match_() && this->firmware_bin_is_valid_()) {
+    ESP_LOGW(TAG, "Expected XMOS version: %u.%u.%u; found: %u.%u.%u. Updating...", this->firmware_bin_version_major_,
+             this->firmware_bin_version_minor_, this->firmware_bin_version_patch_, this->firmware_version_major_,
+             this->firmware_version_minor_, this->firmware_version_patch_);
+    this->start_dfu_update();
+  } else {
+    this->write_pipeline_stages();
+  }
 }
 
 void VoiceKit::dump_config() {
   ESP_LOGCONFIG(TAG, "Voice Kit:");
   LOG_I2C_DEVICE(this);
   LOG_PIN("  Reset Pin: ", this->reset_pin_);
+  ESP_LOGCONFIG(TAG, "  Boot timeout: %" PRIu32 " ms", this->boot_timeout_ms_);
+  if (this->register_poll_interval_ > 0) {
+    ESP_LOGCONFIG(TAG, "  Register poll interval: %" PRIu32 " ms", this->register_poll_interval_);
+    ESP_LOGCONFIG(TAG, "  VNR threshold: %u", this->vnr_threshold_);
+  }
   if (this->firmware_version_major_ || this->firmware_version_minor_ || this->firmware_version_patch_) {
     ESP_LOGCONFIG(TAG, "  XMOS firmware version: %u.%u.%u", this->firmware_version_major_,
                   this->firmware_version_minor_, this->firmware_version_patch_);
@@ -59,32 +104,119 @@ void VoiceKit::loop() {
     case UPDATE_FAILED:
     case UPDATE_BAD_STATE:
 #ifdef USE_VOICE_KIT_STATE_CALLBACK
-      this->state_callback_.call(DFU_ERROR, this->bytes_written_ * 100.0f / this->firmware_bin_length_,
+      this->state_callback_.call(DFU_ERROR, this->bytes_written_ * 100.0f / this->update_length_,
                                  this->dfu_update_status_);
 #endif
+      if (this->streamed_update_) {
+        // The XMOS keeps booting its factory image, so stay usable and let the host retry
+        ESP_LOGW(TAG, "Streamed update failed (status %u)", this->dfu_update_status_);
+        this->dfu_abort_();
+        this->end_streamed_update_();
+        this->dfu_update_status_ = UPDATE_OK;
+        break;
+      }
       this->mark_failed();
       break;
 
+    case UPDATE_OK:
+      this->poll_registers_();
+      break;
+
     default:
       break;
   }
 }
 
+void VoiceKit::poll_registers_() {
+  if (this->register_poll_interval_ == 0 || !this->version_read_()) {
+    return;
+  }
+  const uint32_t now = millis();
+
+  if (this->register_poll_awaiting_) {
+    uint8_t resp[2];
+    if (this->read(resp, sizeof(resp)) != i2c::ERROR_OK) {
+      this->register_poll_awaiting_ = false;
+      this->register_poll_errors_++;
+      return;
+    }
+    if (resp[0] == CTRL_WAIT && now - this->register_poll_request_ms_ < REGISTER_POLL_RESPONSE_TIMEOUT_MS) {
+      return;  // not serviced yet; read again next iteration
+    }
+    this->register_poll_awaiting_ = false;
+    if (resp[0] != CTRL_DONE) {
+      ESP_LOGV(TAG, "Register 0x%02X poll failed: %u", this->register_poll_command_, resp[0]);
+      this->register_poll_errors_++;
+      return;
+    }
+    this->store_register_(this->register_poll_command_, resp[1]);
+    return;
+  }
+
+  if (now - this->register_poll_last_ms_ < this->register_poll_interval_) {
+    return;
+  }
+  this->register_poll_last_ms_ = now;
+
+  // VNR every poll, except for two slots per cycle that refresh the pipeline stages
+  uint8_t command = CONFIGURATION_SERVICER_RESID_VNR_VALUE;
+  if (this->register_poll_count_ == 0) {
+    command = CONFIGURATION_SERVICER_RESID_CHANNEL_0_PIPELINE_STAGE;
+  } else if (this->register_poll_count_ == 1) {
+    command = CONFIGURATION_SERVICER_RESID_CHANNEL_1_PIPELINE_STAGE;
+  }
+  this->register_poll_count_ = (this->register_poll_count_ + 1) % PIPELINE_STAGE_POLL_DIVIDER;
+
+  const uint8_t req[] = {CONFIGURATION_SERVICER_RESID, uint8_t(command | CONFIGURATION_COMMAND_READ_BIT), 2};
+  if (this->write(req, sizeof(req)) != i2c::ERROR_OK) {
+    this->register_poll_errors_++;
+    return;
+  }
+  this->register_poll_command_ = command;
+  this->register_poll_request_ms_ = now;
+  this->register_poll_awaiting_ = true;
+}
+
+void VoiceKit::store_register_(uint8_t command, uint8_t value) {
+  switch (command) {
+    case CONFIGURATION_SERVICER_RESID_VNR_VALUE: {
+      this->cached_vnr_ = value;
+      this->vnr_valid_ = true;
+      bool above = this->vnr_above_ ? value + VNR_HYSTERESIS >= this->vnr_threshold_ : value >= this->vnr_threshold_;
+      if (above != this->vnr_above_) {
+        this->vnr_above_ = above;
+        ESP_LOGV(TAG, "VNR %u %s threshold %u", value, above ? "reached" : "fell below", this->vnr_threshold_);
+        this->vnr_callback_.call(value, above);
+      }
+      break;
+    }
+    case CONFIGURATION_SERVICER_RESID_CHANNEL_0_PIPELINE_STAGE:
+      this->cached_stages_[0] = static_cast<PipelineStages>(value);
+      break;
+    case CONFIGURATION_SERVICER_RESID_CHANNEL_1_PIPELINE_STAGE:
+      this->cached_stages_[1] = static_cast<PipelineStages>(value);
+      break;
+  }
+}
+
 uint8_t VoiceKit::read_vnr() {
   const uint8_t vnr_req[] = {CONFIGURATION_SERVICER_RESID,
                              CONFIGURATION_SERVICER_RESID_VNR_VALUE | CONFIGURATION_COMMAND_READ_BIT, 2};
   uint8_t vnr_resp[2];
 
+  // A blocking read replaces any poll in flight, whose response would otherwise be read as this one
+  this->register_poll_awaiting_ = false;
   auto error_code = this->write(vnr_req, sizeof(vnr_req));
   if (error_code != i2c::ERROR_OK) {
     ESP_LOGE(TAG, "Request status failed");
-    return 0;
+    return this->cached_vnr_;
   }
   error_code = this->read(vnr_resp, sizeof(vnr_resp));
-  if (error_code != i2c::ERROR_OK) {
+  if (error_code != i2c::ERROR_OK || vnr_resp[0] != CTRL_DONE) {
     ESP_LOGE(TAG, "Failed to read VNR");
-    return 0;
+    return this->cached_vnr_;
   }
+  this->store_register_(CONFIGURATION_SERVICER_RESID_VNR_VALUE, vnr_resp[1]);
   return vnr_resp[1];
 }
 
@@ -98,19 +230,24 @@ PipelineStages VoiceKit::read_pipeline_stage(MicrophoneChannels channel) {
 
   uint8_t stage_resp[2];
 
+  this->register_poll_awaiting_ = false;
   auto error_code = this->write(stage_req, sizeof(stage_req));
   if (error_code != i2c::ERROR_OK) {
     ESP_LOGE(TAG, "Failed to read stage");
+    return this->get_cached_pipeline_stage(channel);
   }
   error_code = this->read(stage_resp, sizeof(stage_resp));
-  if (error_code != i2c::ERROR_OK) {
+  if (error_code != i2c::ERROR_OK || stage_resp[0] != CTRL_DONE) {
     ESP_LOGE(TAG, "Failed to read stage");
+    return this->get_cached_pipeline_stage(channel);
   }
 
+  this->store_register_(channel_register & ~CONFIGURATION_COMMAND_READ_BIT, stage_resp[1]);
   return static_cast<PipelineStages>(stage_resp[1]);
 }
 
 void VoiceKit::write_pipeline_stages() {
+  this->register_poll_awaiting_ = false;
   // Write channel 0 stage
   uint8_t stage_set[] = {CONFIGURATION_SERVICER_RESID, CONFIGURATION_SERVICER_RESID_CHANNEL_0_PIPELINE_STAGE, 1,
                                this->channel_0_stage_};
@@ -118,6 +255,8 @@ void VoiceKit::write_pipeline_stages() {
   auto error_code = this->write(stage_set, sizeof(stage_set));
   if (error_code != i2c::ERROR_OK) {
     ESP_LOGE(TAG, "Failed to write chanenl 0 stage");
+  } else {
+    this->store_register_(CONFIGURATION_SERVICER_RESID_CHANNEL_0_PIPELINE_STAGE, this->channel_0_stage_);
   }
 
   // Write channel 1 stage
@@ -127,6 +266,8 @@ void VoiceKit::write_pipeline_stages() {
   error_code = this->write(stage_set, sizeof(stage_set));
   if (error_code != i2c::ERROR_OK) {
     ESP_LOGE(TAG, "Failed to write channel 1 stage");
+  } else {
+    this->store_register_(CONFIGURATION_SERVICER_RESID_CHANNEL_1_PIPELINE_STAGE, this->channel_1_stage_);
   }
 }
 
@@ -135,7 +276,89 @@ void VoiceKit::start_dfu_update() {
     ESP_LOGE(TAG, "Firmware invalid");
     return;
   }
+  if (this->streamed_update_) {
+    ESP_LOGW(TAG, "Streamed update in progress");
+    return;
+  }
+
+  this->update_length_ = this->firmware_bin_length_;
+  this->begin_update_();
+}
 
+bool VoiceKit::begin_streamed_update(uint32_t length, uint32_t crc32, uint8_t major, uint8_t minor, uint8_t patch) {
+  if (this->dfu_update_status_ != UPDATE_OK || this->streamed_update_) {
+    ESP_LOGW(TAG, "Update already in progress");
+    return false;
+  }
+  if (length == 0) {
+    ESP_LOGE(TAG, "Streamed image is empty");
+    return false;
+  }
+
+  this->stream_buffer_.resize(DFU_STREAM_BUFFER_SIZE);
+  this->stream_offset_ = 0;
+  this->stream_length_ = 0;
+  this->stream_crc_ = 0xFFFFFFFF;
+  this->stream_expected_crc_ = crc32;
+  this->stream_last_data_ms_ = millis();
+  this->streamed_update_ = true;
+  this->set_firmware_version(major, minor, patch);
+  this->update_length_ = length;
+  ESP_LOGI(TAG, "Receiving %" PRIu32 " byte image for %u.%u.%u", length, major, minor, patch);
+  this->begin_update_();
+  if (this->dfu_update_status_ != UPDATE_IN_PROGRESS) {
+    // start failed before the XMOS saw any data; loop() reports it
+    return false;
+  }
+  return true;
+}
+
+size_t VoiceKit::write_update_data(const uint8_t *data, size_t length) {
+  if (!this->streamed_update_ || this->dfu_update_status_ != UPDATE_IN_PROGRESS) {
+    return 0;
+  }
+  // Move the unsent tail to the front; it is never more than a few blocks
+  if (this->stream_offset_ > 0) {
+    memmove(this->stream_buffer_.data(), this->stream_buffer_.data() + this->stream_offset_,
+            this->stream_length_ - this->stream_offset_);
+    this->stream_length_ -= this->stream_offset_;
+    this->stream_offset_ = 0;
+  }
+  // Never take bytes past the announced end of the image
+  size_t image_remaining = this->update_length_ - this->bytes_written_ - this->stream_length_;
+  size_t accepted = std::min({length, this->stream_buffer_.size() - this->stream_length_, image_remaining});
+  memcpy(this->stream_buffer_.data() + this->stream_length_, data, accepted);
+  this->stream_length_ += accepted;
+  if (accepted > 0) {
+    this->stream_last_data_ms_ = millis();
+  }
+  return accepted;
+}
+
+void VoiceKit::abort_streamed_update() {
+  if (this->streamed_update_ && this->dfu_update_status_ == UPDATE_IN_PROGRESS) {
+    ESP_LOGW(TAG, "Streamed update aborted");
+    this->dfu_update_status_ = UPDATE_FAILED;
+  }
+}
+
+void VoiceKit::end_streamed_update_() {
+  this->streamed_update_ = false;
+  this->stream_buffer_.clear();
+  this->stream_buffer_.shrink_to_fit();
+  this->stream_offset_ = 0;
+  this->stream_length_ = 0;
+}
+
+bool VoiceKit::update_block_available_() const {
+  if (!this->streamed_update_) {
+    return true;
+  }
+  uint32_t block = std::min<uint32_t>(MAX_XFER, this->update_length_ - this->bytes_written_);
+  return this->stream_length_ - this->stream_offset_ >= block;
+}
+
+void VoiceKit::begin_update_() {
   ESP_LOGI(TAG, "Starting update from %u.%u.%u...", this->firmware_version_major_, this->firmware_version_minor_,
            this->firmware_version_patch_);
 #ifdef USE_VOICE_KIT_STATE_CALLBACK
@@ -160,22 +383,36 @@ VoiceKitUpdaterStatus VoiceKit::dfu_update_send_block_() {
   uint8_t dfu_dnload_req[MAX_XFER + 6] = {240, 1, 130,  // resid, cmd_id, payload length,
                                           0, 0};        // additional payload length (set below)
                                                         // followed by payload data with null terminator
+  if (this->bytes_written_ < this->update_length_ && !this->update_block_available_()) {
+    // Waiting on the host rather than the XMOS
+    if (millis() - this->stream_last_data_ms_ > DFU_STREAM_TIMEOUT_MS) {
+      ESP_LOGE(TAG, "Streamed image stalled at %" PRIu32 " of %" PRIu32 " bytes", this->bytes_written_,
+               this->update_length_);
+      return UPDATE_TIMEOUT;
+    }
+    this->last_ready_ = millis();
+    return UPDATE_IN_PROGRESS;
+  }
+
   if (millis() > this->last_ready_ + DFU_TIMEOUT_MS) {
     ESP_LOGE(TAG, "DFU timed out");
     return UPDATE_TIMEOUT;
   }
 
-  if (this->bytes_written_ < this->firmware_bin_length_) {
-    if (!this->dfu_check_if_ready_()) {
-      return UPDATE_IN_PROGRESS;
-    }
-
-    // read a maximum of MAX_XFER bytes into buffer (real read size is returned)
-    auto bufsize = this->load_buf_(&dfu_dnload_req[5], MAX_XFER, this->bytes_written_);
-    ESP_LOGVV(TAG, "size = %u, bytes written = %u, bufsize = %u", this->firmware_bin_length_, this->bytes_written_,
-              bufsize);
+  if (this->bytes_written_ < this->update_length_) {
+    // Push as many blocks as the XMOS accepts within the loop budget. Each block still needs its GETSTATUS (that is
+    // what moves the XMOS out of DNLOAD_SYNC), but the poll is only issued once the delay it asked for has elapsed.
+    const uint32_t deadline = millis() + DFU_LOOP_BUDGET_MS;
+    while (this->bytes_written_ < this->update_length_ && this->update_block_available_() &&
+           this->dfu_wait_if_ready_(deadline)) {
+      // read a maximum of MAX_XFER bytes into buffer (real read size is returned)
+      auto bufsize = this->load_buf_(&dfu_dnload_req[5], MAX_XFER, this->bytes_written_);
+      ESP_LOGVV(TAG, "size = %u, bytes written = %u, bufsize = %u", this->update_length_, this->bytes_written_,
+                bufsize);
+      if (bufsize == 0 || bufsize > MAX_XFER) {
+        break;
+      }
 
-    if (bufsize > 0 && bufsize <= MAX_XFER) {
       // write bytes to XMOS
       dfu_dnload_req[3] = (uint8_t) bufsize;
       error_code = this->write(dfu_dnload_req, sizeof(dfu_dnload_req) - 1);
@@ -184,13 +421,17 @@ VoiceKitUpdaterStatus VoiceKit::dfu_update_send_block_() {
         return UPDATE_COMMUNICATION_ERROR;
       }
       this->bytes_written_ += bufsize;
+      if (this->streamed_update_) {
+        this->stream_crc_ = crc32_update(this->stream_crc_, &dfu_dnload_req[5], bufsize);
+        this->stream_offset_ += bufsize;
+      }
     }
 
     uint32_t now = millis();
-    if ((now - this->last_progress_ > 1000) or (this->bytes_written_ == this->firmware_bin_length_)) {
+    if ((now - this->last_progress_ > 1000) or (this->bytes_written_ == this->update_length_)) {
       this->last_progress_ = now;
-      float percentage = this->bytes_written_ * 100.0f / this->firmware_bin_length_;
-      ESP_LOGD(TAG, "Progress: %0.1f%%", percentage);
+      float percentage = this->bytes_written_ * 100.0f / this->update_length_;
+      ESP_LOGD(TAG, "Progress: %0.1f%% (%.1f KB/s)", percentage, this->get_dfu_transfer_rate());
 #ifdef USE_VOICE_KIT_STATE_CALLBACK
       this->state_callback_.call(DFU_IN_PROGRESS, percentage, UPDATE_IN_PROGRESS);
 #endif
@@ -202,6 +443,12 @@ VoiceKitUpdaterStatus VoiceKit::dfu_update_send_block_() {
         if (!this->dfu_check_if_ready_()) {
           return UPDATE_IN_PROGRESS;
         }
+        // The final request makes the XMOS commit the new image, so a corrupted stream must not get this far
+        if (this->streamed_update_ && ~this->stream_crc_ != this->stream_expected_crc_) {
+          ESP_LOGE(TAG, "Streamed image CRC mismatch: expected %08" PRIX32 ", got %08" PRIX32,
+                   this->stream_expected_crc_, ~this->stream_crc_);
+          return UPDATE_FAILED;
+        }
         memset(&dfu_dnload_req[3], 0, MAX_XFER + 2);
         // send empty download request to conclude DFU download
         error_code = this->write(dfu_dnload_req, sizeof(dfu_dnload_req) - 1);
@@ -215,8 +462,8 @@ VoiceKitUpdaterStatus VoiceKit::dfu_update_send_block_() {
         if (!this->dfu_check_if_ready_()) {
           return UPDATE_REBOOT_PENDING;
         }
-        ESP_LOGI(TAG, "Done in %.0f seconds -- rebooting XMOS SoC...",
-                 float(millis() - this->update_start_time_) / 1000);
+        ESP_LOGI(TAG, "Done in %.0f seconds (%.1f KB/s) -- rebooting XMOS SoC...",
+                 float(millis() - this->update_start_time_) / 1000, this->get_dfu_transfer_rate());
         if (!this->dfu_reboot_()) {
           return UPDATE_COMMUNICATION_ERROR;
         }
@@ -237,6 +484,9 @@ VoiceKitUpdaterStatus VoiceKit::dfu_update_send_block_() {
           return UPDATE_FAILED;
         }
         ESP_LOGI(TAG, "Update complete");
+        if (this->streamed_update_) {
+          this->end_streamed_update_();
+        }
 #ifdef USE_VOICE_KIT_STATE_CALLBACK
         this->state_callback_.call(DFU_COMPLETE, 100.0f, UPDATE_OK);
 #endif
@@ -252,22 +502,36 @@ VoiceKitUpdaterStatus VoiceKit::dfu_update_send_block_() {
 }
 
 uint32_t VoiceKit::load_buf_(uint8_t *buf, const uint8_t max_len, const uint32_t offset) {
-  if (offset > this->firmware_bin_length_) {
+  if (offset > this->update_length_) {
     ESP_LOGE(TAG, "Invalid offset");
     return 0;
   }
 
-  uint32_t buf_len = this->firmware_bin_length_ - offset;
+  uint32_t buf_len = this->update_length_ - offset;
   if (buf_len > max_len) {
     buf_len = max_len;
   }
 
-  for (uint8_t i = 0; i < max_len; i++) {
-    buf[i] = this->firmware_bin_[offset + i];
+  if (this->streamed_update_) {
+    // the staging buffer starts at bytes_written_, so offset is implied
+    buf_len = std::min<uint32_t>(buf_len, this->stream_length_ - this->stream_offset_);
+    memcpy(buf, this->stream_buffer_.data() + this->stream_offset_, buf_len);
+  } else {
+    memcpy(buf, this->firmware_bin_ + offset, buf_len);
   }
+  // the request always carries max_len payload bytes; pad the last block rather than reading past the image
+  memset(buf + buf_len, 0, max_len - buf_len);
   return buf_len;
 }
 
+float VoiceKit::get_dfu_transfer_rate() const {
+  uint32_t elapsed = millis() - this->update_start_time_;
+  if (elapsed == 0) {
+    return 0.0f;
+  }
+  return this->bytes_written_ / 1.024f / elapsed;
+}
+
 bool VoiceKit::version_read_() {
   return this->firmware_version_major_ || this->firmware_version_minor_ || this->firmware_version_patch_;
 }
@@ -302,20 +566,24 @@ bool VoiceKit::dfu_get_status_() {
   return true;
 }
 
-bool VoiceKit::dfu_get_version_() {
+bool VoiceKit::dfu_get_version_(bool quiet) {
   const uint8_t version_req[] = {DFU_CONTROLLER_SERVICER_RESID,
                                  DFU_CONTROLLER_SERVICER_RESID_DFU_GETVERSION | DFU_COMMAND_READ_BIT, 4};
   uint8_t version_resp[4];
 
   auto error_code = this->write(version_req, sizeof(version_req));
   if (error_code != i2c::ERROR_OK) {
-    ESP_LOGW(TAG, "Request version failed");
+    if (!quiet) {
+      ESP_LOGW(TAG, "Request version failed");
+    }
     return false;
   }
 
   error_code = this->read(version_resp, sizeof(version_resp));
   if (error_code != i2c::ERROR_OK || version_resp[0] != CTRL_DONE) {
-    ESP_LOGW(TAG, "Read version failed");
+    if (!quiet) {
+      ESP_LOGW(TAG, "Read version failed");
+    }
     return false;
   }
 
@@ -338,6 +606,17 @@ bool VoiceKit::dfu_reboot_() {
   return true;
 }
 
+bool VoiceKit::dfu_abort_() {
+  const uint8_t abort_req[] = {DFU_CONTROLLER_SERVICER_RESID, DFU_CONTROLLER_SERVICER_RESID_DFU_ABORT, 0};
+
+  auto error_code = this->write(abort_req, sizeof(abort_req));
+  if (error_code != i2c::ERROR_OK) {
+    ESP_LOGE(TAG, "Abort request failed");
+    return false;
+  }
+  return true;
+}
+
 bool VoiceKit::dfu_set_alternate_() {
   const uint8_t setalternate_req[] = {DFU_CONTROLLER_SERVICER_RESID, DFU_CONTROLLER_SERVICER_RESID_DFU_SETALTERNATE, 1,
                                       DFU_INT_ALTERNATE_UPGRADE};  // resid, cmd_id, payload length, payload data
@@ -367,5 +646,20 @@ bool VoiceKit::dfu_check_if_ready_() {
   return false;
 }
 
+bool VoiceKit::dfu_wait_if_ready_(uint32_t deadline) {
+  while (!this->dfu_check_if_ready_()) {
+    // sleep until the XMOS wants to be polled again, as long as that still falls within the budget
+    const uint32_t next_req = this->status_last_read_ms_ + this->dfu_status_next_req_delay_;
+    const uint32_t now = millis();
+    if (next_req >= deadline || now > this->last_ready_ + DFU_TIMEOUT_MS) {
+      return false;
+    }
+    if (next_req > now) {
+      delay(next_req - now);
+    }
+  }
+  return true;
+}
+
 }  // namespace voice_kit
 }  // namespace esphome
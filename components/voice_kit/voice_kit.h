@@ -6,6 +6,8 @@
 #include "esphome/core/defines.h"
 #include "esphome/core/hal.h"
 
+#include <vector>
+
 namespace esphome {
 namespace voice_kit {
 
@@ -20,6 +22,21 @@ static const uint8_t DFU_COMMAND_READ_BIT = 0x80;
 
 static const uint16_t DFU_TIMEOUT_MS = 1000;
 static const uint16_t MAX_XFER = 128;  // maximum number of bytes we can transfer per block
+// Time per loop() iteration spent pushing DFU blocks; the XMOS usually answers GETSTATUS with a short (or zero) delay,
+// so several blocks fit into one iteration without hogging the main loop
+static const uint32_t DFU_LOOP_BUDGET_MS = 20;
+// Host-streamed images are staged in a small buffer in front of the DFU state machine; the host has to keep it fed
+static const size_t DFU_STREAM_BUFFER_SIZE = 8 * MAX_XFER;
+static const uint32_t DFU_STREAM_TIMEOUT_MS = 5000;
+// GETVERSION probing after the reset pulse: first probe, then doubling intervals up to the maximum
+static const uint32_t BOOT_PROBE_FIRST_DELAY_MS = 50;
+static const uint32_t BOOT_PROBE_FIRST_INTERVAL_MS = 20;
+static const uint32_t BOOT_PROBE_MAX_INTERVAL_MS = 250;
+
+// Background register poller: a request goes out in one loop() iteration and its response is read in a later one
+static const uint32_t REGISTER_POLL_RESPONSE_TIMEOUT_MS = 50;
+static const uint8_t PIPELINE_STAGE_POLL_DIVIDER = 20;  // one in every this many polls refreshes a pipeline stage
+static const uint8_t VNR_HYSTERESIS = 5;
 
 enum TransportProtocolReturnCode : uint8_t {
   CTRL_DONE = 0,
@@ -136,6 +153,10 @@ class VoiceKit : public Component, public i2c::I2CDevice {
   }
 #endif
   void set_reset_pin(GPIOPin *reset_pin) { reset_pin_ = reset_pin; }
+  // How long setup() keeps probing for the XMOS after reset before marking the component failed
+  void set_boot_timeout(uint32_t timeout_ms) { this->boot_timeout_ms_ = timeout_ms; }
+  // The XMOS has answered and no update is running, so control requests and audio can be relied on
+  bool is_xmos_ready() { return this->version_read_() && this->dfu_update_status_ == UPDATE_OK; }
 
   void set_firmware_bin(const uint8_t *data, const uint32_t len) {
     this->firmware_bin_ = data;
@@ -149,6 +170,17 @@ class VoiceKit : public Component, public i2c::I2CDevice {
 
   void start_dfu_update();
 
+  // Updates the XMOS from an image the caller streams in with write_update_data() instead of the embedded one. The
+  // CRC-32 (IEEE) of the whole image is checked before the update is concluded, then the XMOS is expected to report
+  // the given version after its reboot. A failed streamed update leaves the component usable, so it can be retried.
+  bool begin_streamed_update(uint32_t length, uint32_t crc32, uint8_t major, uint8_t minor, uint8_t patch);
+  // Stages the next image bytes; returns how many were taken, which may be fewer than length (or none)
+  size_t write_update_data(const uint8_t *data, size_t length);
+  void abort_streamed_update();
+  bool is_streamed_update_active() const { return this->streamed_update_; }
+  // Average DFU download rate since the update started, in KB/s
+  float get_dfu_transfer_rate() const;
+
   void set_channel_0_stage(PipelineStages channel_0_stage) { this->channel_0_stage_ = channel_0_stage; }
   void set_channel_1_stage(PipelineStages channel_1_stage) { this->channel_1_stage_ = channel_1_stage; }
 
@@ -157,6 +189,23 @@ class VoiceKit : public Component, public i2c::I2CDevice {
 
   PipelineStages read_pipeline_stage(MicrophoneChannels channel);
 
+  // Keeps cached VNR and pipeline stage values fresh without blocking loop(); 0 disables the poller
+  void set_register_poll_interval(uint32_t interval_ms) { this->register_poll_interval_ = interval_ms; }
+  uint32_t get_register_poll_interval() const { return this->register_poll_interval_; }
+  void set_vnr_threshold(uint8_t threshold) { this->vnr_threshold_ = threshold; }
+  // Called with the VNR whenever it crosses the threshold: above is true once it reaches it, false once it falls
+  // VNR_HYSTERESIS below it again
+  void add_on_vnr_callback(std::function<void(uint8_t, bool)> &&callback) {
+    this->vnr_callback_.add(std::move(callback));
+  }
+  bool has_vnr() const { return this->vnr_valid_; }
+  uint8_t get_cached_vnr() const { return this->cached_vnr_; }
+  bool is_vnr_above_threshold() const { return this->vnr_above_; }
+  PipelineStages get_cached_pipeline_stage(MicrophoneChannels channel) const {
+    return this->cached_stages_[channel == MICROPHONE_CHANNEL_1 ? 1 : 0];
+  }
+  uint32_t get_register_poll_errors() const { return this->register_poll_errors_; }
+
  protected:
 #ifdef USE_VOICE_KIT_STATE_CALLBACK
   CallbackManager<void(DFUAutomationState, float, VoiceKitUpdaterStatus)> state_callback_{};
@@ -167,11 +216,41 @@ class VoiceKit : public Component, public i2c::I2CDevice {
   bool version_read_();
   bool versions_match_();
 
+  void probe_boot_();
+  void finish_boot_();
+
+  void poll_registers_();
+  void store_register_(uint8_t command, uint8_t value);
+
   bool dfu_get_status_();
-  bool dfu_get_version_();
+  bool dfu_get_version_(bool quiet = false);
   bool dfu_reboot_();
   bool dfu_set_alternate_();
   bool dfu_check_if_ready_();
+  bool dfu_wait_if_ready_(uint32_t deadline);
+  bool dfu_abort_();
+  void begin_update_();
+  bool update_block_available_() const;
+  void end_streamed_update_();
+
+  uint32_t boot_timeout_ms_{10000};
+  uint32_t boot_start_ms_{0};
+  uint32_t boot_probe_interval_ms_{0};
+  uint32_t boot_probes_{0};
+
+  uint32_t register_poll_interval_{0};
+  uint32_t register_poll_last_ms_{0};
+  uint32_t register_poll_request_ms_{0};
+  uint32_t register_poll_errors_{0};
+  uint8_t register_poll_count_{0};
+  uint8_t register_poll_command_{0};
+  bool register_poll_awaiting_{false};
+  uint8_t cached_vnr_{0};
+  bool vnr_valid_{false};
+  uint8_t vnr_threshold_{0};
+  bool vnr_above_{true};  // fail open until the first reading says otherwise
+  PipelineStages cached_stages_[2]{PIPELINE_STAGE_NONE, PIPELINE_STAGE_NONE};
+  CallbackManager<void(uint8_t, bool)> vnr_callback_{};
 
   PipelineStages channel_0_stage_;
   PipelineStages channel_1_stage_;
@@ -192,12 +271,23 @@ class VoiceKit : public Component, public i2c::I2CDevice {
   uint8_t firmware_version_minor_{0};
   uint8_t firmware_version_patch_{0};
 
+  // Image currently being written, either firmware_bin_ or the streamed one
+  uint32_t update_length_{0};
   uint32_t bytes_written_{0};
   uint32_t last_progress_{0};
   uint32_t last_ready_{0};
   uint32_t status_last_read_ms_{0};
   uint32_t update_start_time_{0};
   VoiceKitUpdaterStatus dfu_update_status_{UPDATE_OK};
+
+  // Streamed image staging; bytes [stream_offset_, stream_length_) of stream_buffer_ are the next ones to send
+  bool streamed_update_{false};
+  std::vector<uint8_t> stream_buffer_;
+  size_t stream_offset_{0};
+  size_t stream_length_{0};
+  uint32_t stream_crc_{0};
+  uint32_t stream_expected_crc_{0};
+  uint32_t stream_last_data_ms_{0};
 };
 
 }  // namespace voice_kit
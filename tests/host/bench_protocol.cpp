@@ -0,0 +1,292 @@
+// Host benchmarks of the control and playback protocol path, replaying a recorded RX session (corpus/).
+//
+// The component is the device source compiled against the stubs in stubs/, so these numbers track relative changes
+// to parsing, dispatch and buffering; they are not device timings (use the benchmark message for those).
+//
+//   usb_communication_bench [--benchmark_filter=...]
+//
+// USB_BENCH_CORPUS overrides the corpus file.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "host_stubs.h"
+#include "usb_communication/json_message.h"
+#include "usb_communication/usb_communication.h"
+#include "usb_communication/usb_frame.h"
+
+namespace {
+
+using esphome::usb_communication::FRAME_HEADER_SIZE;
+using esphome::usb_communication::FRAME_MAGIC_0;
+using esphome::usb_communication::FRAME_MAGIC_1;
+using esphome::usb_communication::FRAME_TYPE_AUDIO_DATA;
+using esphome::usb_communication::JsonMessage;
+using esphome::usb_communication::USBCommunicationComponent;
+using esphome::usb_communication::for_each_json_int;
+
+// Exposes the protected dispatch entry point; everything else goes through the public API
+class Harness : public USBCommunicationComponent {
+ public:
+  using USBCommunicationComponent::process_message_;
+};
+
+// Accepts everything immediately, so playback never backs up into the component's buffer
+class NullSpeaker : public esphome::speaker::Speaker {
+ public:
+  size_t play(const uint8_t *data, size_t length) override {
+    benchmark::DoNotOptimize(data);
+    return length;
+  }
+  void start() override {}
+  void stop() override {}
+  bool has_buffered_data() const override { return false; }
+};
+
+struct Corpus {
+  std::string raw;
+  std::vector<std::string> lines;
+  std::vector<std::string> audio_frames;  // FRAME_TYPE_AUDIO_DATA payloads
+};
+
+// Splits the RX stream the same way the device does: binary frames start with the magic, everything else is a line
+Corpus load_corpus() {
+  Corpus corpus;
+  const char *path = std::getenv("USB_BENCH_CORPUS");
+  if (path == nullptr) {
+    path = USB_BENCH_DEFAULT_CORPUS;
+  }
+  FILE *file = std::fopen(path, "rb");
+  if (file == nullptr) {
+    std::fprintf(stderr, "Cannot open corpus %s\n", path);
+    return corpus;
+  }
+  char buffer[4096];
+  size_t read;
+  while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    corpus.raw.append(buffer, read);
+  }
+  std::fclose(file);
+
+  const auto *data = reinterpret_cast<const uint8_t *>(corpus.raw.data());
+  size_t pos = 0;
+  while (pos < corpus.raw.size()) {
+    if (data[pos] == FRAME_MAGIC_0 && pos + FRAME_HEADER_SIZE <= corpus.raw.size() && data[pos + 1] == FRAME_MAGIC_1) {
+      size_t length = data[pos + 6] | (data[pos + 7] << 8);
+      if (data[pos + 2] == FRAME_TYPE_AUDIO_DATA) {
+        corpus.audio_frames.push_back(corpus.raw.substr(pos + FRAME_HEADER_SIZE, length));
+      }
+      pos += FRAME_HEADER_SIZE + length;
+      continue;
+    }
+    size_t end = corpus.raw.find('\n', pos);
+    if (end == std::string::npos) {
+      end = corpus.raw.size();
+    }
+    corpus.lines.push_back(corpus.raw.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  return corpus;
+}
+
+const Corpus &corpus() {
+  static const Corpus CORPUS = load_corpus();
+  return CORPUS;
+}
+
+std::string_view message_type(const std::string &line) {
+  JsonMessage message;
+  return message.parse(line) ? message.type() : std::string_view();
+}
+
+std::vector<const std::string *> lines_of_type(std::initializer_list<std::string_view> types) {
+  std::vector<const std::string *> lines;
+  for (const std::string &line : corpus().lines) {
+    std::string_view type = message_type(line);
+    for (std::string_view wanted : types) {
+      if (type == wanted) {
+        lines.push_back(&line);
+      }
+    }
+  }
+  return lines;
+}
+
+class ProtocolFixture : public benchmark::Fixture {
+ public:
+  // Google Benchmark may call SetUp() more than once per fixture; the component is set up only the first time
+  void SetUp(const benchmark::State &state) override {
+    host_stub::set_keep_tx(false);
+    if (this->ready_) {
+      return;
+    }
+    this->component_.set_playback_buffer_size(32 * 1024);
+    this->component_.setup();
+    // Attached after setup(), as the YAML does from on_boot
+    this->component_.set_speaker(&this->speaker_);
+    this->ready_ = true;
+  }
+
+  // Hands queued responses to the (discarding) port so the TX queue never fills and starts dropping
+  void drain() { this->component_.loop(); }
+
+ protected:
+  NullSpeaker speaker_;
+  Harness component_;
+  bool ready_{false};
+};
+
+// Parse and dispatch of the small control messages that make up most of the traffic
+BENCHMARK_F(ProtocolFixture, ProcessMessageDispatch)(benchmark::State &state) {
+  auto lines = lines_of_type({"heartbeat", "get_status", "get_wake_word_options", "config"});
+  if (lines.empty()) {
+    state.SkipWithError("corpus has no control messages");
+    return;
+  }
+  size_t bytes = 0;
+  for (auto _ : state) {
+    for (const std::string *line : lines) {
+      this->component_.process_message_(*line);
+      bytes += line->size();
+    }
+    state.PauseTiming();
+    this->drain();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * lines.size());
+  state.SetBytesProcessed(bytes);
+}
+
+// The decimal array decoder on its own, over every audio array in the corpus
+static void BM_DecimalAudioDecode(benchmark::State &state) {
+  std::vector<std::string_view> arrays;
+  for (const std::string &line : corpus().lines) {
+    JsonMessage message;
+    if (!message.parse(line)) {
+      continue;
+    }
+    for (std::string_view key : {"data", "audio_data"}) {
+      std::string_view array = message.get_raw(key);
+      if (!array.empty()) {
+        arrays.push_back(array);
+      }
+    }
+  }
+  if (arrays.empty()) {
+    state.SkipWithError("corpus has no decimal audio");
+    return;
+  }
+  size_t bytes = 0;
+  size_t values = 0;
+  for (auto _ : state) {
+    for (std::string_view array : arrays) {
+      long sum = 0;
+      values += for_each_json_int(array, [&sum](long value) { sum += value; });
+      benchmark::DoNotOptimize(sum);
+      bytes += array.size();
+    }
+  }
+  state.SetItemsProcessed(values);
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_DecimalAudioDecode);
+
+// audio_data_chunk messages end to end: tokenize, decode the byte array and buffer it for playback
+BENCHMARK_F(ProtocolFixture, AudioDataChunk)(benchmark::State &state) {
+  auto chunks = lines_of_type({"audio_data_chunk"});
+  if (chunks.empty()) {
+    state.SkipWithError("corpus has no audio_data_chunk messages");
+    return;
+  }
+  const std::string start = "{\"type\":\"start_audio_stream\",\"codec\":\"pcm\"}";
+  size_t bytes = 0;
+  for (auto _ : state) {
+    this->component_.process_message_(start);
+    for (const std::string *line : chunks) {
+      this->component_.process_message_(*line);
+      bytes += line->size();
+    }
+    state.PauseTiming();
+    this->drain();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * chunks.size());
+  state.SetBytesProcessed(bytes);
+}
+
+// A full play_audio_chunk transfer, including the reordered and duplicated chunks the corpus contains
+BENCHMARK_F(ProtocolFixture, ChunkReassembly)(benchmark::State &state) {
+  auto lines = lines_of_type({"play_audio_chunk"});
+  if (lines.empty()) {
+    state.SkipWithError("corpus has no play_audio_chunk messages");
+    return;
+  }
+  size_t bytes = 0;
+  for (auto _ : state) {
+    for (const std::string *line : lines) {
+      this->component_.process_message_(*line);
+      bytes += line->size();
+    }
+    state.PauseTiming();
+    this->drain();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * lines.size());
+  state.SetBytesProcessed(bytes);
+}
+
+// write_audio_chunk with the corpus PCM frames, at the speaker rate (a copy) and through the resampler
+BENCHMARK_DEFINE_F(ProtocolFixture, WriteAudioChunk)(benchmark::State &state) {
+  const auto &frames = corpus().audio_frames;
+  if (frames.empty()) {
+    state.SkipWithError("corpus has no audio frames");
+    return;
+  }
+  const std::string start = "{\"type\":\"start_audio_stream\",\"codec\":\"pcm\",\"sample_rate\":" +
+                            std::to_string(state.range(0)) + "}";
+  // Enough input per stream to stay clear of the buffer limit even when upsampling 2x
+  const size_t budget = 12 * 1024;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    this->component_.process_message_(start);
+    size_t written = 0;
+    for (size_t i = 0; written < budget; i = (i + 1) % frames.size()) {
+      const std::string &frame = frames[i];
+      this->component_.write_audio_chunk(reinterpret_cast<const uint8_t *>(frame.data()), frame.size());
+      written += frame.size();
+    }
+    bytes += written;
+    state.PauseTiming();
+    this->drain();
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK_REGISTER_F(ProtocolFixture, WriteAudioChunk)->Arg(8000)->Arg(16000)->Arg(22050)->Arg(48000);
+
+// The whole session through the RX path: framing, line assembly, dispatch and playback
+BENCHMARK_F(ProtocolFixture, ReplaySession)(benchmark::State &state) {
+  const std::string &raw = corpus().raw;
+  if (raw.empty()) {
+    state.SkipWithError("corpus is empty");
+    return;
+  }
+  for (auto _ : state) {
+    host_stub::feed_rx(reinterpret_cast<const uint8_t *>(raw.data()), raw.size());
+    while (host_stub::rx_pending() > 0) {
+      this->component_.loop();
+    }
+    this->component_.loop();
+  }
+  state.SetBytesProcessed(state.iterations() * raw.size());
+}
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Writes host_session.bin, the RX byte stream the host benchmarks replay.
+
+The session is synthetic but uses the message shapes the macOS app sends: control traffic, a PCM stream of binary
+AUDIO_DATA frames at the speaker rate and at 22.05 kHz, legacy decimal audio_data_chunk and play_audio messages, and
+a play_audio_chunk transfer with reordered and duplicated chunks. The output is deterministic, so regenerate it with
+
+    python3 tests/host/corpus/make_corpus.py
+
+after changing this script and commit both files.
+"""
+
+import math
+import os
+import struct
+
+FRAME_MAGIC = b"\xa5\x5a"
+FRAME_TYPE_AUDIO_DATA = 0x01
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+class Session:
+    def __init__(self):
+        self.out = bytearray()
+        self.sequence = 0
+
+    def line(self, text):
+        self.out += text.encode() + b"\n"
+
+    def frame(self, frame_type, payload):
+        header = struct.pack("<BBHH", frame_type, 0, self.sequence, len(payload))
+        crc = crc16_ccitt(header + payload)
+        self.out += FRAME_MAGIC + header + struct.pack("<H", crc) + payload
+        self.sequence = (self.sequence + 1) & 0xFFFF
+
+
+def tone(count, rate, frequency, phase=0):
+    # A tone with a little deterministic noise, so the decimal arrays have realistic digit counts
+    state = 12345 + phase
+    samples = []
+    for i in range(count):
+        state = (state * 1103515245 + 12345) & 0x7FFFFFFF
+        noise = (state >> 16) % 512 - 256
+        value = int(12000 * math.sin(2 * math.pi * frequency * (i + phase) / rate)) + noise
+        samples.append(max(-32768, min(32767, value)))
+    return samples
+
+
+def pcm(samples):
+    return struct.pack("<%dh" % len(samples), *samples)
+
+
+def decimal(values):
+    return "[" + ",".join(str(v) for v in values) + "]"
+
+
+def main():
+    session = Session()
+    timestamp = 1700000000
+
+    session.line('{"type":"get_status","timestamp":%d}' % timestamp)
+    session.line('{"type":"get_wake_word_options","timestamp":%d}' % timestamp)
+    session.line('{"type":"config","volume":0.6,"timestamp":%d}' % timestamp)
+    session.line('{"type":"config","voice_phase":"idle","timestamp":%d}' % timestamp)
+    for i in range(8):
+        session.line('{"type":"heartbeat","timestamp":%d}' % (timestamp + i))
+
+    # 0.5 s of binary PCM at the speaker rate, in 20 ms frames
+    session.line('{"type":"start_audio_stream","codec":"pcm","sample_rate":16000,"timestamp":%d}' % timestamp)
+    for i in range(25):
+        session.frame(FRAME_TYPE_AUDIO_DATA, pcm(tone(320, 16000, 440, i * 320)))
+    session.line('{"type":"finish_audio_stream","timestamp":%d}' % timestamp)
+
+    # The same at 22.05 kHz, which the device resamples
+    session.line('{"type":"start_audio_stream","codec":"pcm","sample_rate":22050,"timestamp":%d}' % timestamp)
+    for i in range(25):
+        session.frame(FRAME_TYPE_AUDIO_DATA, pcm(tone(441, 22050, 440, i * 441)))
+    session.line('{"type":"finish_audio_stream","timestamp":%d}' % timestamp)
+
+    # Legacy decimal byte arrays
+    session.line('{"type":"start_audio_stream","codec":"pcm","timestamp":%d}' % timestamp)
+    for i in range(8):
+        data = pcm(tone(512, 16000, 660, i * 512))
+        session.line('{"type":"audio_data_chunk","seq":%d,"data":%s,"timestamp":%d}' %
+                     (i + 1, decimal(data), timestamp))
+    session.line('{"type":"finish_audio_stream","timestamp":%d}' % timestamp)
+
+    session.line('{"type":"play_audio","audio_data":%s,"timestamp":%d}' %
+                 (decimal(tone(1600, 16000, 880)), timestamp))
+    for i in range(4):
+        session.line('{"type":"play_audio","batch":%d,"total_batches":4,"audio_data":%s,"timestamp":%d}' %
+                     (i + 1, decimal(tone(800, 16000, 880, i * 800)), timestamp))
+
+    # Chunked transfer: 16 chunks of 512 samples, the last one short, with two swapped pairs and a duplicate
+    chunks = [tone(512, 16000, 523, i * 512) for i in range(15)] + [tone(200, 16000, 523, 15 * 512)]
+    session.line('{"type":"play_audio_chunk","is_start":true,"total_chunks":%d,"chunk_samples":512,'
+                 '"timestamp":%d}' % (len(chunks), timestamp))
+    order = [0, 2, 1, 3, 4, 5, 7, 6, 6, 8, 9, 10, 11, 12, 13, 14, 15]
+    for index in order:
+        session.line('{"type":"play_audio_chunk","chunk_index":%d,"audio_data":%s,"timestamp":%d}' %
+                     (index + 1, decimal(chunks[index]), timestamp))
+
+    session.line('{"type":"get_status","timestamp":%d}' % timestamp)
+
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "host_session.bin")
+    with open(path, "wb") as f:
+        f.write(session.out)
+    print("wrote %d bytes to %s" % (len(session.out), path))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "freertos/FreeRTOS.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+
+typedef struct {
+  uint32_t tx_buffer_size;
+  uint32_t rx_buffer_size;
+} usb_serial_jtag_driver_config_t;
+
+#define USB_SERIAL_JTAG_DRIVER_CONFIG_DEFAULT() {256, 256}
+
+// Backed by host_stub::feed_rx() and host_stub::take_tx()
+esp_err_t usb_serial_jtag_driver_install(usb_serial_jtag_driver_config_t *config);
+bool usb_serial_jtag_is_driver_installed(void);
+int usb_serial_jtag_read_bytes(void *buf, uint32_t length, TickType_t ticks_to_wait);
+int usb_serial_jtag_write_bytes(const void *src, size_t size, TickType_t ticks_to_wait);
+esp_err_t usb_serial_jtag_wait_tx_done(TickType_t ticks_to_wait);
@@ -0,0 +1,3 @@
+#pragma once
+
+void esp_vfs_usb_serial_jtag_use_driver(void);
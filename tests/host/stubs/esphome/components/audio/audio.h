@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace audio {
+
+class AudioStreamInfo {
+ public:
+  AudioStreamInfo(uint8_t bits_per_sample = 16, uint8_t channels = 1, uint32_t sample_rate = 16000)
+      : bits_per_sample_(bits_per_sample), channels_(channels), sample_rate_(sample_rate) {}
+
+  uint8_t get_bits_per_sample() const { return this->bits_per_sample_; }
+  uint8_t get_channels() const { return this->channels_; }
+  uint32_t get_sample_rate() const { return this->sample_rate_; }
+
+  uint32_t frames_to_bytes(uint32_t frames) const { return frames * this->frame_size_(); }
+  uint32_t bytes_to_frames(size_t bytes) const { return bytes / this->frame_size_(); }
+  uint32_t ms_to_bytes(uint32_t ms) const { return ms * this->sample_rate_ / 1000 * this->frame_size_(); }
+
+ protected:
+  uint32_t frame_size_() const { return this->channels_ * this->bits_per_sample_ / 8; }
+
+  uint8_t bits_per_sample_;
+  uint8_t channels_;
+  uint32_t sample_rate_;
+};
+
+}  // namespace audio
+}  // namespace esphome
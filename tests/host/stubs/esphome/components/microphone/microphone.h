@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "esphome/components/audio/audio.h"
+
+namespace esphome {
+namespace microphone {
+
+// Never delivers data; the host build has no capture path
+class Microphone {
+ public:
+  virtual void start() = 0;
+  virtual void stop() = 0;
+
+  void add_data_callback(std::function<void(const std::vector<uint8_t> &)> &&callback) {}
+  bool is_running() const { return true; }
+  bool is_stopped() const { return false; }
+  audio::AudioStreamInfo get_audio_stream_info() { return audio::AudioStreamInfo(32, 2, 16000); }
+};
+
+}  // namespace microphone
+}  // namespace esphome
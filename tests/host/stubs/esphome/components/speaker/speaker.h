@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/components/audio/audio.h"
+#include "freertos/FreeRTOS.h"
+
+namespace esphome {
+namespace speaker {
+
+class Speaker {
+ public:
+  virtual size_t play(const uint8_t *data, size_t length) = 0;
+  virtual size_t play(const uint8_t *data, size_t length, TickType_t ticks_to_wait) {
+    return this->play(data, length);
+  }
+  virtual void start() = 0;
+  virtual void stop() = 0;
+  virtual void finish() { this->stop(); }
+  virtual bool has_buffered_data() const = 0;
+
+  bool is_running() const { return true; }
+  bool is_stopped() const { return false; }
+
+  void set_audio_stream_info(const audio::AudioStreamInfo &info) { this->audio_stream_info_ = info; }
+  audio::AudioStreamInfo &get_audio_stream_info() { return this->audio_stream_info_; }
+
+ protected:
+  audio::AudioStreamInfo audio_stream_info_;
+};
+
+}  // namespace speaker
+}  // namespace esphome
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+
+template<typename... Ts> class Trigger {
+ public:
+  void trigger(Ts... x) {}
+};
+
+template<typename... Ts> class Action {
+ public:
+  virtual void play(Ts... x) = 0;
+};
+
+template<typename... Ts> class Condition {
+ public:
+  virtual bool check(Ts... x) = 0;
+};
+
+}  // namespace esphome
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+
+namespace setup_priority {
+const float HARDWARE = 800;
+const float DATA = 600;
+const float AFTER_CONNECTION = 100;
+const float LATE = -100;
+}  // namespace setup_priority
+
+// Scheduler calls are accepted and dropped; tests drive setup() and loop() directly
+class Component {
+ public:
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual bool can_proceed() { return true; }
+  virtual float get_setup_priority() const { return 0; }
+
+  bool is_failed() const { return false; }
+  void mark_failed() {}
+  void status_set_warning() {}
+  void status_clear_warning() {}
+
+ protected:
+  void set_timeout(uint32_t timeout, std::function<void()> &&f) {}
+  void set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f) {}
+  bool cancel_timeout(const std::string &name) { return true; }
+  void set_interval(uint32_t interval, std::function<void()> &&f) {}
+  void set_interval(const std::string &name, uint32_t interval, std::function<void()> &&f) {}
+  bool cancel_interval(const std::string &name) { return true; }
+  void defer(std::function<void()> &&f) {}
+};
+
+}  // namespace esphome
@@ -0,0 +1,3 @@
+#pragma once
+
+// No optional features: the host build covers the component without voice_kit or tracing
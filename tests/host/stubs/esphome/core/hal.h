@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+
+// Monotonic host clock, starting at zero when the process starts
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+class GPIOPin {
+ public:
+  virtual void setup() {}
+  virtual void digital_write(bool value) {}
+};
+
+}  // namespace esphome
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace esphome {
+
+template<typename T> class CallbackManager;
+template<typename... Ts> class CallbackManager<void(Ts...)> {
+ public:
+  void add(std::function<void(Ts...)> &&callback) { this->callbacks_.push_back(std::move(callback)); }
+  void call(Ts... args) {
+    for (auto &callback : this->callbacks_) {
+      callback(args...);
+    }
+  }
+  size_t size() const { return this->callbacks_.size(); }
+
+ protected:
+  std::vector<std::function<void(Ts...)>> callbacks_;
+};
+
+constexpr uint32_t encode_uint24(uint8_t byte1, uint8_t byte2, uint8_t byte3) {
+  return (uint32_t(byte1) << 16) | (uint32_t(byte2) << 8) | byte3;
+}
+constexpr uint16_t encode_uint16(uint8_t msb, uint8_t lsb) { return (uint16_t(msb) << 8) | lsb; }
+
+// Always allocates from the host heap, whatever the flags ask for
+template<class T> class RAMAllocator {
+ public:
+  enum : uint8_t {
+    NONE = 0,
+    ALLOC_EXTERNAL = 1 << 0,
+    ALLOC_INTERNAL = 1 << 1,
+    ALLOW_FAILURE = 1 << 2,
+  };
+
+  RAMAllocator(uint8_t flags = 0) {}
+  T *allocate(size_t n) { return new T[n]; }
+  void deallocate(T *p, size_t n) { delete[] p; }
+};
+template<class T> using ExternalRAMAllocator = RAMAllocator<T>;
+
+}  // namespace esphome
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdio>
+
+// Log calls are type checked like printf but print nothing, so benchmarks measure the protocol path only
+#define ESP_HOST_LOG_(...) \
+  do { \
+    if (false) { \
+      printf(__VA_ARGS__); \
+    } \
+  } while (false)
+#define ESP_LOGE(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ESP_HOST_LOG_(__VA_ARGS__)
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+
+namespace esphome {
+
+// Host stub of the FreeRTOS-backed byte ring; write() overwrites the oldest bytes like the real one
+class RingBuffer {
+ public:
+  size_t read(void *data, size_t len, TickType_t ticks_to_wait = 0);
+  size_t write(const void *data, size_t len);
+  size_t write_without_replacement(const void *data, size_t len, TickType_t ticks_to_wait = 0);
+  size_t available() const { return this->used_; }
+  size_t free() const { return this->storage_.size() - this->used_; }
+  BaseType_t reset();
+  static std::unique_ptr<RingBuffer> create(size_t len);
+
+ protected:
+  std::vector<uint8_t> storage_;
+  size_t head_{0};
+  size_t used_{0};
+};
+
+}  // namespace esphome
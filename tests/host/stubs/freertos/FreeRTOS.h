@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void *TaskHandle_t;
+
+#define pdMS_TO_TICKS(x) (x)
+#define pdPASS 1
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffff
@@ -0,0 +1,154 @@
+#include "host_stubs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "driver/usb_serial_jtag.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_vfs_usb_serial_jtag.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/ring_buffer.h"
+#include "freertos/task.h"
+
+namespace {
+
+const auto START = std::chrono::steady_clock::now();
+
+std::string rx_pending_bytes;
+size_t rx_position = 0;
+std::string tx_data;
+size_t tx_total = 0;
+bool keep_tx = true;
+bool driver_installed = false;
+bool tasks_enabled = false;
+bool on_task = false;
+int task_handle_storage;  // the address is the handle of the one task the stubs hand out
+
+uint64_t elapsed_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - START).count();
+}
+
+}  // namespace
+
+namespace host_stub {
+
+void feed_rx(const uint8_t *data, size_t length) {
+  rx_pending_bytes.append(reinterpret_cast<const char *>(data), length);
+}
+
+size_t rx_pending() { return rx_pending_bytes.size() - rx_position; }
+
+std::string take_tx() {
+  std::string out;
+  out.swap(tx_data);
+  return out;
+}
+
+void set_keep_tx(bool keep) { keep_tx = keep; }
+size_t tx_bytes() { return tx_total; }
+
+void set_tasks_enabled(bool enabled) { tasks_enabled = enabled; }
+void set_on_task(bool task) { on_task = task; }
+
+}  // namespace host_stub
+
+namespace esphome {
+
+uint32_t millis() { return static_cast<uint32_t>(elapsed_us() / 1000); }
+uint32_t micros() { return static_cast<uint32_t>(elapsed_us()); }
+void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void delayMicroseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+size_t RingBuffer::read(void *data, size_t len, TickType_t ticks_to_wait) {
+  size_t count = len < this->used_ ? len : this->used_;
+  size_t tail = (this->head_ + this->storage_.size() - this->used_) % this->storage_.size();
+  for (size_t i = 0; i < count; i++) {
+    static_cast<uint8_t *>(data)[i] = this->storage_[(tail + i) % this->storage_.size()];
+  }
+  this->used_ -= count;
+  return count;
+}
+
+size_t RingBuffer::write(const void *data, size_t len) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < len; i++) {
+    this->storage_[this->head_] = bytes[i];
+    this->head_ = (this->head_ + 1) % this->storage_.size();
+  }
+  this->used_ = this->used_ + len < this->storage_.size() ? this->used_ + len : this->storage_.size();
+  return len;
+}
+
+size_t RingBuffer::write_without_replacement(const void *data, size_t len, TickType_t ticks_to_wait) {
+  size_t count = len < this->free() ? len : this->free();
+  return this->write(data, count);
+}
+
+BaseType_t RingBuffer::reset() {
+  this->head_ = 0;
+  this->used_ = 0;
+  return pdPASS;
+}
+
+std::unique_ptr<RingBuffer> RingBuffer::create(size_t len) {
+  auto ring = std::unique_ptr<RingBuffer>(new RingBuffer());
+  ring->storage_.resize(len);
+  return ring;
+}
+
+}  // namespace esphome
+
+void *heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) { return calloc(n, size); }
+void heap_caps_free(void *ptr) { free(ptr); }
+size_t heap_caps_get_free_size(uint32_t caps) { return 8 * 1024 * 1024; }
+
+int64_t esp_timer_get_time() { return static_cast<int64_t>(elapsed_us()); }
+
+esp_err_t usb_serial_jtag_driver_install(usb_serial_jtag_driver_config_t *cfg) {
+  driver_installed = true;
+  return ESP_OK;
+}
+bool usb_serial_jtag_is_driver_installed() { return driver_installed; }
+
+int usb_serial_jtag_read_bytes(void *buf, uint32_t length, TickType_t ticks_to_wait) {
+  size_t count = std::min<size_t>(length, rx_pending_bytes.size() - rx_position);
+  memcpy(buf, rx_pending_bytes.data() + rx_position, count);
+  rx_position += count;
+  if (rx_position == rx_pending_bytes.size()) {
+    rx_pending_bytes.clear();
+    rx_position = 0;
+  }
+  return static_cast<int>(count);
+}
+
+int usb_serial_jtag_write_bytes(const void *src, size_t size, TickType_t ticks_to_wait) {
+  if (keep_tx) {
+    tx_data.append(static_cast<const char *>(src), size);
+  }
+  tx_total += size;
+  return static_cast<int>(size);
+}
+
+esp_err_t usb_serial_jtag_wait_tx_done(TickType_t ticks_to_wait) { return ESP_OK; }
+void esp_vfs_usb_serial_jtag_use_driver() {}
+
+// No pipeline task on the host: `task:` configurations fail to start it and run from loop() instead, unless a test
+// enabled tasks to drive the task side itself
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *handle,
+                                   BaseType_t) {
+  if (!tasks_enabled) {
+    return pdFALSE;
+  }
+  *handle = &task_handle_storage;
+  return pdPASS;
+}
+void vTaskDelay(TickType_t) {}
+void vTaskDelete(TaskHandle_t) {}
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) { return 0; }
+void xTaskNotifyGive(TaskHandle_t) {}
+TaskHandle_t xTaskGetCurrentTaskHandle() { return on_task ? &task_handle_storage : nullptr; }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Hooks into the host stubs for tests and benchmarks
+namespace host_stub {
+
+// Bytes the next usb_serial_jtag_read_bytes() calls hand to the component
+void feed_rx(const uint8_t *data, size_t length);
+// Fed bytes the component has not read yet
+size_t rx_pending();
+// Everything the component wrote to the port since the last call
+std::string take_tx();
+// When false, writes are counted and discarded instead of kept for take_tx()
+void set_keep_tx(bool keep);
+size_t tx_bytes();
+
+// When enabled, xTaskCreatePinnedToCore() succeeds without running the task, so a test can call the task's work
+// itself; set_on_task() makes xTaskGetCurrentTaskHandle() report that task instead of the main loop
+void set_tasks_enabled(bool enabled);
+void set_on_task(bool on_task);
+
+}  // namespace host_stub
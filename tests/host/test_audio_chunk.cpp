@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "host_stubs.h"
+#include "usb_communication/usb_communication.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+class Harness : public USBCommunicationComponent {
+ public:
+  using USBCommunicationComponent::process_message_;
+};
+
+// Keeps every byte it is handed
+class CaptureSpeaker : public speaker::Speaker {
+ public:
+  size_t play(const uint8_t *data, size_t length) override {
+    this->played.insert(this->played.end(), data, data + length);
+    return length;
+  }
+  void start() override {}
+  void stop() override {}
+  bool has_buffered_data() const override { return false; }
+
+  std::vector<uint8_t> played;
+};
+
+// Streams the same PCM as one chunk per entry of split_at (byte offsets) and returns what reached the speaker
+std::vector<uint8_t> stream(uint32_t sample_rate, const std::vector<uint8_t> &pcm, const std::vector<size_t> &split_at) {
+  CaptureSpeaker speaker;
+  speaker.set_audio_stream_info(audio::AudioStreamInfo(16, 1, 16000));
+  Harness component;
+  component.setup();
+  component.set_speaker(&speaker);
+
+  component.process_message_(R"({"type":"start_audio_stream","codec":"pcm","sample_rate":)" +
+                             std::to_string(sample_rate) + "}");
+  size_t start = 0;
+  for (size_t end : split_at) {
+    component.write_audio_chunk(pcm.data() + start, end - start);
+    start = end;
+  }
+  component.write_audio_chunk(pcm.data() + start, pcm.size() - start);
+  component.process_message_(R"({"type":"finish_audio_stream"})");
+  for (int i = 0; i < 50; i++) {
+    component.loop();
+  }
+  return speaker.played;
+}
+
+std::vector<uint8_t> ramp(size_t samples) {
+  std::vector<uint8_t> pcm;
+  for (size_t i = 0; i < samples; i++) {
+    auto sample = static_cast<int16_t>(i * 37 - 9000);
+    pcm.push_back(static_cast<uint8_t>(sample & 0xFF));
+    pcm.push_back(static_cast<uint8_t>((sample >> 8) & 0xFF));
+  }
+  return pcm;
+}
+
+TEST(AudioChunk, OddSplitKeepsSamplesAligned) {
+  std::vector<uint8_t> pcm = ramp(1000);
+  std::vector<uint8_t> whole = stream(16000, pcm, {});
+  ASSERT_EQ(whole, pcm);
+  EXPECT_EQ(stream(16000, pcm, {301}), whole);
+  EXPECT_EQ(stream(16000, pcm, {1, 2, 3, 1001}), whole);
+}
+
+TEST(AudioChunk, OddSplitKeepsSamplesAlignedThroughResampler) {
+  std::vector<uint8_t> pcm = ramp(1000);
+  std::vector<uint8_t> whole = stream(22050, pcm, {});
+  ASSERT_FALSE(whole.empty());
+  EXPECT_EQ(stream(22050, pcm, {301}), whole);
+  EXPECT_EQ(stream(22050, pcm, {1, 2, 3, 1001}), whole);
+}
+
+TEST(AudioChunk, CarryDoesNotLeakIntoNextStream) {
+  CaptureSpeaker speaker;
+  speaker.set_audio_stream_info(audio::AudioStreamInfo(16, 1, 16000));
+  Harness component;
+  component.setup();
+  component.set_speaker(&speaker);
+
+  const uint8_t odd[3] = {0x11, 0x22, 0x33};
+  component.process_message_(R"({"type":"start_audio_stream","codec":"pcm"})");
+  component.write_audio_chunk(odd, sizeof(odd));
+  component.process_message_(R"({"type":"finish_audio_stream"})");
+  for (int i = 0; i < 10; i++) {
+    component.loop();
+  }
+  ASSERT_EQ(speaker.played, std::vector<uint8_t>({0x11, 0x22}));
+
+  const uint8_t next[2] = {0x44, 0x55};
+  component.process_message_(R"({"type":"start_audio_stream","codec":"pcm"})");
+  component.write_audio_chunk(next, sizeof(next));
+  component.process_message_(R"({"type":"finish_audio_stream"})");
+  for (int i = 0; i < 10; i++) {
+    component.loop();
+  }
+  EXPECT_EQ(speaker.played, std::vector<uint8_t>({0x11, 0x22, 0x44, 0x55}));
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "host_stubs.h"
+#include "usb_communication/device_state.h"
+#include "usb_communication/json_message.h"
+#include "usb_communication/usb_communication.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+TEST(DeviceState, CommitBumpsVersionOncePerBatch) {
+  DeviceState state;
+  state.set(STATE_VOLUME, state.volume, 0.3f);
+  state.set(STATE_TIMER_RINGING, state.timer_ringing, true);
+  EXPECT_EQ(state.version, 0u);
+  EXPECT_EQ(state.commit(), STATE_VOLUME | STATE_TIMER_RINGING);
+  EXPECT_EQ(state.version, 1u);
+  EXPECT_EQ(state.dirty, 0);
+
+  // Nothing changed: no new version
+  state.set(STATE_VOLUME, state.volume, 0.3f);
+  EXPECT_EQ(state.commit(), 0);
+  EXPECT_EQ(state.version, 1u);
+}
+
+TEST(DeviceState, DeltaVersionFollowsPreviousVersion) {
+  USBCommunicationComponent component;
+  component.setup();
+  host_stub::set_keep_tx(true);
+  component.update_volume(0.2f);
+  component.loop();
+  host_stub::take_tx();
+
+  component.update_volume(0.4f);
+  component.update_timer_ringing(true);
+  component.loop();
+  std::string tx = host_stub::take_tx();
+  size_t start = tx.find("{\"type\":\"status_delta\"");
+  ASSERT_NE(start, std::string::npos);
+  std::string line = tx.substr(start, tx.find('\n', start) - start);
+
+  JsonMessage delta;
+  ASSERT_TRUE(delta.parse(line));
+  EXPECT_EQ(delta.get_int<uint32_t>("version", 0), 2u);
+  EXPECT_FLOAT_EQ(delta.get_float("volume", 0.0f), 0.4f);
+  EXPECT_TRUE(delta.get_bool("timer_ringing", false));
+  EXPECT_EQ(tx.find("status_delta", start + line.size()), std::string::npos);
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome
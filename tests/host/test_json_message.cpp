@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "usb_communication/json_message.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+TEST(JsonMessage, ReadsFlatFields) {
+  JsonMessage message;
+  ASSERT_TRUE(message.parse(R"({"type":"config","volume":0.5,"unmute":true,"seq":42,"data":[1,2,3]})"));
+  EXPECT_EQ(message.type(), "config");
+  EXPECT_FLOAT_EQ(message.get_float("volume", -1.0f), 0.5f);
+  EXPECT_TRUE(message.get_bool("unmute", false));
+  EXPECT_EQ(message.get_int<int>("seq", 0), 42);
+  EXPECT_EQ(message.get_raw("data"), "[1,2,3]");
+  EXPECT_FALSE(message.has("missing"));
+  EXPECT_EQ(message.get_int<int>("missing", 7), 7);
+}
+
+TEST(JsonMessage, RejectsTruncatedMessage) {
+  JsonMessage message;
+  EXPECT_FALSE(message.parse(R"({"type":"config","volume":)"));
+}
+
+TEST(ForEachJsonInt, DecodesSignedValuesAndSkipsOthers) {
+  std::vector<long> values;
+  size_t count = for_each_json_int("[-32768, 0,12,x, 32767]", [&values](long value) { values.push_back(value); });
+  EXPECT_EQ(count, 4u);
+  EXPECT_EQ(values, (std::vector<long>{-32768, 0, 12, 32767}));
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome
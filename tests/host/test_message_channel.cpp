@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "usb_communication/message_channel.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+const uint8_t *bytes(const std::string &text) { return reinterpret_cast<const uint8_t *>(text.data()); }
+
+TEST(MessageChannel, RefusesMessagesLongerThanTheLimit) {
+  std::vector<uint8_t> storage(1024);
+  MessageChannel channel;
+  ASSERT_TRUE(channel.init(storage.data(), storage.size(), 64));
+
+  const std::string fits(63, 'a');
+  const std::string newline = "\n";
+  EXPECT_TRUE(channel.push(bytes(fits), fits.size(), bytes(newline), 1));
+  const std::string oversize(65, 'b');
+  EXPECT_FALSE(channel.push(bytes(oversize), oversize.size()));
+  EXPECT_EQ(channel.dropped(), 1u);
+
+  uint8_t buffer[64];
+  EXPECT_EQ(channel.pop(buffer, sizeof(buffer)), 64u);
+  EXPECT_EQ(channel.pop(buffer, sizeof(buffer)), 0u);
+}
+
+TEST(MessageChannel, PopSkipsMessagesTooLongForTheBuffer) {
+  std::vector<uint8_t> storage(1024);
+  MessageChannel channel;
+  ASSERT_TRUE(channel.init(storage.data(), storage.size(), 256));
+
+  const std::string first = "first";
+  const std::string oversize(200, 'x');
+  const std::string last = "last";
+  ASSERT_TRUE(channel.push(bytes(first), first.size()));
+  ASSERT_TRUE(channel.push(bytes(oversize), oversize.size()));
+  ASSERT_TRUE(channel.push(bytes(last), last.size()));
+
+  // A drain loop stopping at the first 0 still gets every message that fits
+  uint8_t buffer[16];
+  std::vector<std::string> received;
+  size_t length;
+  while ((length = channel.pop(buffer, sizeof(buffer))) > 0) {
+    received.emplace_back(reinterpret_cast<const char *>(buffer), length);
+  }
+  EXPECT_EQ(received, std::vector<std::string>({first, last}));
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "host_stubs.h"
+#include "usb_communication/resampler.h"
+#include "usb_communication/usb_communication.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+class Harness : public USBCommunicationComponent {
+ public:
+  using USBCommunicationComponent::process_message_;
+};
+
+class NullSpeaker : public speaker::Speaker {
+ public:
+  size_t play(const uint8_t *data, size_t length) override { return length; }
+  void start() override {}
+  void stop() override {}
+  bool has_buffered_data() const override { return false; }
+};
+
+// A resampler with its own coefficient storage, as setup() carves it from the arena
+class TestResampler : public Resampler {
+ public:
+  TestResampler() : storage(COEFFICIENT_COUNT) { this->init(this->storage.data()); }
+
+  std::vector<int16_t> storage;
+};
+
+TEST(Resampler, RejectsRatiosBeyondTheOutputBlock) {
+  TestResampler resampler;
+  EXPECT_FALSE(resampler.configure(50, 16000));
+  EXPECT_FALSE(resampler.configure(1000, 16000));
+  EXPECT_TRUE(resampler.configure(8000, 48000));
+  EXPECT_TRUE(resampler.configure(22050, 16000));
+}
+
+TEST(Resampler, HighRatioKeepsDcLevel) {
+  TestResampler resampler;
+  ASSERT_TRUE(resampler.configure(8000, 48000));
+  std::vector<int16_t> input(400, 8000);
+  std::vector<int16_t> output(resampler.max_output(input.size()));
+  size_t used = 0;
+  size_t produced = resampler.process(input.data(), input.size(), output.data(), output.size(), &used);
+  EXPECT_EQ(used, input.size());
+  EXPECT_EQ(produced, input.size() * 6);
+  // Past the filter's start-up the output settles on the input level
+  for (size_t i = produced / 2; i < produced; i++) {
+    EXPECT_NEAR(output[i], 8000, 100) << "at " << i;
+  }
+}
+
+TEST(Resampler, ConsumesNothingWithoutRoomForOneInput) {
+  TestResampler resampler;
+  ASSERT_TRUE(resampler.configure(8000, 48000));
+  int16_t input[4] = {};
+  int16_t output[5];
+  size_t used = 1;
+  EXPECT_EQ(resampler.process(input, 4, output, 5, &used), 0u);
+  EXPECT_EQ(used, 0u);
+}
+
+TEST(Resampler, NeedsStorage) {
+  Resampler resampler;
+  EXPECT_FALSE(resampler.configure(8000, 16000));
+}
+
+TEST(Resampler, SameRatioKeepsTheTable) {
+  TestResampler resampler;
+  ASSERT_TRUE(resampler.configure(22050, 16000));
+  std::vector<int16_t> input(300);
+  for (size_t i = 0; i < input.size(); i++) {
+    input[i] = static_cast<int16_t>((i * 97) % 4000 - 2000);
+  }
+  std::vector<int16_t> first(resampler.max_output(input.size()));
+  size_t used = 0;
+  size_t produced = resampler.process(input.data(), input.size(), first.data(), first.size(), &used);
+
+  // Marks the table: a rebuild would overwrite this entry
+  const std::vector<int16_t> table(resampler.storage.begin(), resampler.storage.end());
+  resampler.storage[0] = 12345;
+  ASSERT_TRUE(resampler.configure(44100, 32000));
+  EXPECT_EQ(resampler.storage[0], 12345);
+  resampler.storage[0] = table[0];
+
+  // The stream state still starts over
+  std::vector<int16_t> second(first.size());
+  EXPECT_EQ(resampler.process(input.data(), input.size(), second.data(), second.size(), &used), produced);
+  EXPECT_EQ(second, first);
+
+  // A new ratio rebuilds
+  resampler.storage[0] = 12345;
+  ASSERT_TRUE(resampler.configure(8000, 16000));
+  EXPECT_NE(resampler.storage[0], 12345);
+}
+
+TEST(Resampler, StreamAtUnsupportedRateIsRefusedAndWritesReturn) {
+  NullSpeaker speaker;
+  speaker.set_audio_stream_info(audio::AudioStreamInfo(16, 1, 16000));
+  Harness component;
+  component.setup();
+  component.set_speaker(&speaker);
+  host_stub::set_keep_tx(true);
+  host_stub::take_tx();
+
+  component.process_message_(R"({"type":"start_audio_stream","codec":"pcm","sample_rate":50})");
+  component.loop();
+  EXPECT_NE(host_stub::take_tx().find("unsupported_sample_rate"), std::string::npos);
+
+  // A rate the resampler accepts still streams; this used to be where an oversized ratio spun forever
+  component.process_message_(R"({"type":"start_audio_stream","codec":"pcm","sample_rate":8000})");
+  std::vector<int16_t> samples(1024, 1000);
+  component.write_audio_chunk(reinterpret_cast<const uint8_t *>(samples.data()), samples.size() * sizeof(int16_t));
+  component.loop();
+  EXPECT_NE(host_stub::take_tx().find("\"output_sample_rate\":16000"), std::string::npos);
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome
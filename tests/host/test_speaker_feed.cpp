@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "host_stubs.h"
+#include "usb_communication/usb_communication.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+bool running_on_task = false;
+
+class Harness : public USBCommunicationComponent {
+ public:
+  using USBCommunicationComponent::process_message_;
+  using USBCommunicationComponent::run_pipeline_;
+};
+
+// Takes up to 512 bytes per call and records which thread of control called it
+class RecordingSpeaker : public speaker::Speaker {
+ public:
+  size_t play(const uint8_t *data, size_t length) override {
+    if (running_on_task) {
+      this->calls_from_task++;
+    }
+    size_t taken = std::min<size_t>(length, 512);
+    this->played += taken;
+    return taken;
+  }
+  void start() override { this->starts++; }
+  void stop() override {}
+  void finish() override {
+    this->finishes++;
+    this->played_at_finish = this->played;
+  }
+  bool has_buffered_data() const override { return false; }
+
+  size_t played{0};
+  size_t played_at_finish{0};
+  int calls_from_task{0};
+  int starts{0};
+  int finishes{0};
+};
+
+class SpeakerFeedTest : public ::testing::Test {
+ protected:
+  void SetUp() override { host_stub::set_tasks_enabled(true); }
+  void TearDown() override {
+    host_stub::set_on_task(false);
+    host_stub::set_tasks_enabled(false);
+  }
+
+  // One pass of the pipeline task, then one main loop iteration
+  void cycle() {
+    this->on_task(true);
+    this->component_.run_pipeline_();
+    this->on_task(false);
+    this->component_.loop();
+  }
+
+  void on_task(bool task) {
+    host_stub::set_on_task(task);
+    running_on_task = task;
+  }
+
+  RecordingSpeaker speaker_;
+  Harness component_;
+};
+
+TEST_F(SpeakerFeedTest, PipelineTaskNeverCallsTheSpeaker) {
+  this->component_.set_task_config(1, 10, 8192);
+  this->component_.setup();
+  this->component_.set_speaker(&this->speaker_);
+
+  std::vector<int16_t> samples(6000, 1000);
+  this->on_task(true);
+  this->component_.process_message_(R"({"type":"start_audio_stream","codec":"pcm"})");
+  this->component_.write_audio_chunk(reinterpret_cast<const uint8_t *>(samples.data()),
+                                     samples.size() * sizeof(int16_t));
+  this->component_.process_message_(R"({"type":"finish_audio_stream"})");
+  this->on_task(false);
+  EXPECT_EQ(this->speaker_.played, 0u);
+
+  for (int i = 0; i < 200 && this->speaker_.played < samples.size() * sizeof(int16_t); i++) {
+    this->cycle();
+  }
+  this->cycle();
+  EXPECT_EQ(this->speaker_.calls_from_task, 0);
+  EXPECT_EQ(this->speaker_.starts, 1);
+  EXPECT_EQ(this->speaker_.played, samples.size() * sizeof(int16_t));
+  // finish() waited for the audio staged ahead of it
+  EXPECT_EQ(this->speaker_.finishes, 1);
+  EXPECT_EQ(this->speaker_.played_at_finish, samples.size() * sizeof(int16_t));
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome
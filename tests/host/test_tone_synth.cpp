@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "usb_communication/tone_synth.h"
+
+namespace esphome {
+namespace usb_communication {
+namespace {
+
+class Synth : public ToneSynth {
+ public:
+  using ToneSynth::envelope_at_;
+};
+
+// 60 s attack, then a long decay and release, in one 65 s note at 16 kHz: each stage runs far past the 131075
+// samples where a Q15 level times a position overflows 32 bits
+TEST(ToneSynth, LongEnvelopeStagesDoNotWrap) {
+  Synth synth;
+  synth.set_sample_rate(16000);
+  synth.set_envelope(ToneSynth::Envelope{60000, 2000, 16384, 3000});
+  ASSERT_TRUE(synth.add_note(440, 65000, 0));
+  const uint32_t attack = 60000 * 16;
+  const uint32_t decay = 2000 * 16;
+  const uint32_t note = 65000 * 16;
+  const uint32_t release = 3000 * 16;
+
+  uint32_t previous = 0;
+  for (uint32_t position = 0; position < attack; position += 1000) {
+    uint32_t level = synth.envelope_at_(position);
+    EXPECT_GE(level, previous) << "attack at " << position;
+    previous = level;
+  }
+  EXPECT_NEAR(synth.envelope_at_(attack / 2), 32767 / 2, 2);
+  EXPECT_NEAR(synth.envelope_at_(attack - 1), 32767, 2);
+
+  // Decay starts from full scale
+  previous = 32767;
+
+  for (uint32_t position = attack; position < attack + decay; position += 1000) {
+    uint32_t level = synth.envelope_at_(position);
+    EXPECT_LE(level, previous) << "decay at " << position;
+    EXPECT_GE(level, 16384u) << "decay at " << position;
+    previous = level;
+  }
+  EXPECT_EQ(synth.envelope_at_(attack + decay), 16384u);
+
+  for (uint32_t position = note - release; position < note; position += 1000) {
+    uint32_t level = synth.envelope_at_(position);
+    EXPECT_LE(level, previous) << "release at " << position;
+    previous = level;
+  }
+  EXPECT_NEAR(synth.envelope_at_(note - release / 2), 16384 / 2, 2);
+}
+
+TEST(ToneSynth, RendersLongNoteToItsEnd) {
+  ToneSynth synth;
+  synth.set_sample_rate(16000);
+  synth.set_envelope(ToneSynth::Envelope{20000, 40, 22938, 40});
+  ASSERT_TRUE(synth.add_note(1000, 30000, 0));
+  std::vector<int16_t> block(1600);
+  size_t total = 0;
+  int peak_late_attack = 0;
+  size_t produced;
+  while ((produced = synth.render(block.data(), block.size())) > 0) {
+    // The last 0.1 s of the attack is near full scale for the default Q15 amplitude of one half
+    if (total >= 19900 * 16 && total < 20000 * 16) {
+      for (size_t i = 0; i < produced; i++) {
+        peak_late_attack = std::max(peak_late_attack, std::abs(static_cast<int>(block[i])));
+      }
+    }
+    total += produced;
+  }
+  EXPECT_EQ(total, 30000u * 16);
+  EXPECT_GT(peak_late_attack, 16000);
+}
+
+}  // namespace
+}  // namespace usb_communication
+}  // namespace esphome